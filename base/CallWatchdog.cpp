@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HidlCallWatchdog"
+
+#include <hidl/CallWatchdog.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/threads.h>
+#include <utils/AndroidThreads.h>
+#include <utils/CallStack.h>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+
+// Calls nested deeper than this on one thread, e.x. a server calling another HAL, are not
+// tracked.
+static constexpr size_t kMaxDepth = 8;
+
+using Event = HidlInstrumentor::InstrumentationEvent;
+
+namespace {
+
+// One call in flight. Written only by its thread and read by the watchdog thread, which uses id
+// like a sequence lock: 0 while the frame is being written, and unique per call otherwise.
+struct Frame {
+    std::atomic<uint64_t> id{0};
+    std::atomic<int64_t> startNanos{0};
+    std::atomic<Event> event{HidlInstrumentor::CLIENT_API_ENTRY};
+    std::atomic<const char*> package{nullptr};
+    std::atomic<const char*> version{nullptr};
+    std::atomic<const char*> interface{nullptr};
+    std::atomic<const char*> method{nullptr};
+
+    // watchdog thread only
+    uint64_t reportedId = 0;
+    int64_t reportedNanos = 0;
+};
+
+struct ThreadCalls {
+    explicit ThreadCalls(pid_t tid) : tid(tid) {}
+
+    const pid_t tid;
+    std::atomic<size_t> depth{0};  // of frames, at most kMaxDepth
+    // owning thread only
+    size_t untracked = 0;  // calls in flight past kMaxDepth
+    uint64_t nextId = 1;
+    Frame frames[kMaxDepth];
+};
+
+struct Watchdog {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::shared_ptr<ThreadCalls>> threads;
+    milliseconds timeout{0};
+    std::map<std::string, milliseconds> timeouts;
+    HungCallHandler handler;
+    bool started = false;
+};
+
+}  // namespace
+
+static Watchdog& watchdog() {
+    static Watchdog& watchdog = *new Watchdog;
+    return watchdog;
+}
+
+// Read on every event, without the watchdog's lock.
+static std::atomic<bool> gEnabled{false};
+
+// Registers this thread with the watchdog on its first call, and unregisters it on exit.
+struct ThreadRegistration {
+    ThreadRegistration() : calls(std::make_shared<ThreadCalls>(base::GetThreadId())) {
+        Watchdog& w = watchdog();
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.threads.push_back(calls);
+    }
+    ~ThreadRegistration() {
+        Watchdog& w = watchdog();
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.threads.erase(std::remove(w.threads.begin(), w.threads.end(), calls), w.threads.end());
+    }
+
+    std::shared_ptr<ThreadCalls> calls;
+};
+
+// this thread's, once it made a call
+static thread_local ThreadCalls* tCalls = nullptr;
+
+static int64_t nowNanos() {
+    return std::chrono::duration_cast<nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static bool equals(const char* a, const char* b) {
+    return a == b || (a != nullptr && b != nullptr && strcmp(a, b) == 0);
+}
+
+// Generated code does not report the exit of every call it reports the entry of, e.x. a proxy
+// returns right away if the transaction fails, and a stub or passthrough wrapper only reports
+// the exit of a method with a callback from that callback. Frames of such calls are dropped when
+// they are known to have returned:
+// - when the exit of a call they are nested in is reported.
+// - a client call only runs code on its thread while waiting for the reply, which is when nested
+//   server calls arrive, and from its callback, once it has the reply. So it is dropped when any
+//   other call starts inside it.
+// - for the same reason, a server call only starts inside a client call, so the frames above the
+//   innermost client call are dropped when one starts.
+// - all of them are dropped when the thread joins the thread pool or handles polled commands, see
+//   resetCallWatchdogThread.
+// Passthrough calls which do not report their exit are only dropped with a call they are nested
+// in.
+static size_t dropReturnedCalls(const ThreadCalls& calls, Event event, size_t depth) {
+    while (depth > 0) {
+        Event top = calls.frames[depth - 1].event.load(std::memory_order_relaxed);
+        bool returned = event == HidlInstrumentor::SERVER_API_ENTRY
+                                ? top != HidlInstrumentor::CLIENT_API_ENTRY
+                                : top == HidlInstrumentor::CLIENT_API_ENTRY;
+        if (!returned) break;
+        depth--;
+    }
+    return depth;
+}
+
+void onCallWatchdogEvent(Event event, const char* package, const char* version,
+                         const char* interface, const char* method) {
+    Event entryEvent;
+    switch (event) {
+        case HidlInstrumentor::SERVER_API_ENTRY:
+        case HidlInstrumentor::CLIENT_API_ENTRY:
+        case HidlInstrumentor::PASSTHROUGH_ENTRY:
+            entryEvent = event;
+            break;
+        case HidlInstrumentor::SERVER_API_EXIT:
+            entryEvent = HidlInstrumentor::SERVER_API_ENTRY;
+            break;
+        case HidlInstrumentor::CLIENT_API_EXIT:
+            entryEvent = HidlInstrumentor::CLIENT_API_ENTRY;
+            break;
+        case HidlInstrumentor::PASSTHROUGH_EXIT:
+            entryEvent = HidlInstrumentor::PASSTHROUGH_ENTRY;
+            break;
+        default:
+            // callbacks run inside the call they belong to
+            return;
+    }
+
+    // Exits are recorded even while the watchdog is stopped, so that the calls in flight are
+    // still right if it starts again.
+    if (entryEvent != event) {
+        if (tCalls == nullptr) return;
+        ThreadCalls& calls = *tCalls;
+        if (calls.untracked > 0) {
+            calls.untracked--;
+            return;
+        }
+        // Innermost first. Frames above the call are of calls which returned without an exit.
+        for (size_t depth = calls.depth.load(std::memory_order_relaxed); depth > 0; --depth) {
+            const Frame& frame = calls.frames[depth - 1];
+            if (frame.event.load(std::memory_order_relaxed) == entryEvent &&
+                equals(frame.method.load(std::memory_order_relaxed), method) &&
+                equals(frame.interface.load(std::memory_order_relaxed), interface) &&
+                equals(frame.version.load(std::memory_order_relaxed), version) &&
+                equals(frame.package.load(std::memory_order_relaxed), package)) {
+                calls.depth.store(depth - 1, std::memory_order_release);
+                return;
+            }
+        }
+        // An exit without an entry is a call which started before the watchdog did, or which
+        // was dropped already.
+        return;
+    }
+    if (!gEnabled.load(std::memory_order_relaxed)) return;
+
+    if (tCalls == nullptr) {
+        thread_local ThreadRegistration registration;
+        tCalls = registration.calls.get();
+    }
+    ThreadCalls& calls = *tCalls;
+    if (calls.untracked > 0) {
+        calls.untracked++;
+        return;
+    }
+    size_t depth = dropReturnedCalls(calls, event, calls.depth.load(std::memory_order_relaxed));
+    if (depth == kMaxDepth) {
+        calls.depth.store(depth, std::memory_order_release);
+        calls.untracked++;
+        return;
+    }
+
+    Frame& frame = calls.frames[depth];
+    frame.id.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    frame.startNanos.store(nowNanos(), std::memory_order_relaxed);
+    frame.event.store(event, std::memory_order_relaxed);
+    frame.package.store(package, std::memory_order_relaxed);
+    frame.version.store(version, std::memory_order_relaxed);
+    frame.interface.store(interface, std::memory_order_relaxed);
+    frame.method.store(method, std::memory_order_relaxed);
+    frame.id.store(calls.nextId++, std::memory_order_release);
+    calls.depth.store(depth + 1, std::memory_order_release);
+}
+
+void resetCallWatchdogThread() {
+    if (tCalls == nullptr) return;
+    tCalls->untracked = 0;
+    tCalls->depth.store(0, std::memory_order_release);
+}
+
+static std::string interfaceName(const char* package, const char* version,
+                                 const char* interface) {
+    return std::string(package ? package : "") + "@" + (version ? version : "") +
+           "::" + (interface ? interface : "");
+}
+
+static void logHungCall(const HungCall& call) {
+    LOG(ERROR) << "HIDL call " << call.descriptor << " on thread " << call.tid
+               << " has not returned after " << call.elapsed.count() << "ms\n"
+               << call.stack;
+}
+
+static void checkThreads(const std::vector<std::shared_ptr<ThreadCalls>>& threads,
+                         milliseconds timeout, const std::map<std::string, milliseconds>& timeouts,
+                         const HungCallHandler& handler) {
+    int64_t now = nowNanos();
+    for (const std::shared_ptr<ThreadCalls>& calls : threads) {
+        size_t depth = std::min(calls->depth.load(std::memory_order_acquire), kMaxDepth);
+
+        // Outermost first, since an outer call is hung if an inner one is. Inner calls which
+        // started before an outer one was reported are part of that report, but ones which
+        // started later are not, e.x. if the outer call is still running because it is waiting
+        // for something else.
+        int64_t reportedNanos = std::numeric_limits<int64_t>::min();
+        for (size_t i = 0; i < depth; ++i) {
+            Frame& frame = calls->frames[i];
+            uint64_t id = frame.id.load(std::memory_order_acquire);
+            if (id == 0) continue;
+            if (id == frame.reportedId) {
+                reportedNanos = std::max(reportedNanos, frame.reportedNanos);
+                continue;
+            }
+
+            int64_t startNanos = frame.startNanos.load(std::memory_order_relaxed);
+            Event event = frame.event.load(std::memory_order_relaxed);
+            const char* package = frame.package.load(std::memory_order_relaxed);
+            const char* version = frame.version.load(std::memory_order_relaxed);
+            const char* interface = frame.interface.load(std::memory_order_relaxed);
+            const char* method = frame.method.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // the call returned, and maybe another started, while reading it
+            if (frame.id.load(std::memory_order_relaxed) != id) continue;
+
+            std::string name = interfaceName(package, version, interface);
+            auto it = timeouts.find(name);
+            milliseconds limit = it == timeouts.end() ? timeout : it->second;
+            nanoseconds elapsed(now - startNanos);
+            if (elapsed < limit) continue;
+            if (startNanos <= reportedNanos) continue;
+
+            frame.reportedId = id;
+            frame.reportedNanos = now;
+            CallStack stack;
+            stack.update(0 /* ignoreDepth */, calls->tid);
+            HungCall hung = {name + "::" + (method ? method : ""), event, calls->tid,
+                             std::chrono::duration_cast<milliseconds>(elapsed),
+                             stack.toString("  ").c_str()};
+            (handler ? handler : logHungCall)(hung);
+            // only the outermost hung call is reported
+            break;
+        }
+    }
+}
+
+static void runWatchdog() {
+    androidSetThreadName("HIDL watchdog");
+
+    Watchdog& w = watchdog();
+    std::unique_lock<std::mutex> lock(w.mutex);
+    while (true) {
+        if (w.timeout.count() == 0) {
+            w.changed.wait(lock);
+            continue;
+        }
+
+        // Reports a hung call within a quarter of the shortest timeout of it hanging.
+        milliseconds period = w.timeout;
+        for (const auto& [interface, timeout] : w.timeouts) period = std::min(period, timeout);
+        period = std::clamp(period / 4, milliseconds(1), milliseconds(1000));
+
+        // Reports are made without the lock, so that the handler may call into the watchdog.
+        std::vector<std::shared_ptr<ThreadCalls>> threads = w.threads;
+        milliseconds timeout = w.timeout;
+        std::map<std::string, milliseconds> timeouts = w.timeouts;
+        HungCallHandler handler = w.handler;
+        lock.unlock();
+        checkThreads(threads, timeout, timeouts, handler);
+        threads.clear();
+        lock.lock();
+
+        w.changed.wait_for(lock, period);
+    }
+}
+
+void startCallWatchdog(milliseconds timeout, HungCallHandler handler) {
+    CHECK_GT(timeout.count(), 0) << "A watchdog needs a timeout";
+
+    Watchdog& w = watchdog();
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.timeout = timeout;
+    w.handler = std::move(handler);
+    if (!w.started) {
+        std::thread(runWatchdog).detach();
+        w.started = true;
+    }
+    gEnabled.store(true, std::memory_order_relaxed);
+    w.changed.notify_all();
+}
+
+void stopCallWatchdog() {
+    Watchdog& w = watchdog();
+    std::lock_guard<std::mutex> lock(w.mutex);
+    gEnabled.store(false, std::memory_order_relaxed);
+    w.timeout = milliseconds(0);
+    w.handler = nullptr;
+    w.changed.notify_all();
+}
+
+bool isCallWatchdogEnabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void setCallWatchdogTimeout(const std::string& interface, milliseconds timeout) {
+    Watchdog& w = watchdog();
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.timeouts[interface] = timeout;
+    w.changed.notify_all();
+}
+
+bool configureCallWatchdog() {
+    static bool configured = [] {
+        uint64_t timeoutMs = base::GetUintProperty<uint64_t>("hidl.watchdog.timeout_ms", 0);
+        if (timeoutMs > 0) startCallWatchdog(milliseconds(timeoutMs));
+        return true;
+    }();
+    (void)configured;
+    return isCallWatchdogEnabled();
+}
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
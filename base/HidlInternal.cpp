@@ -17,6 +17,7 @@
 #define LOG_TAG "HidlInternal"
 
 #include <hidl/HidlInternal.h>
+#include <hidl/CallWatchdog.h>
 
 #ifdef __ANDROID__
 #include <android/api-level.h>
@@ -50,12 +51,17 @@ std::string getVndkSpHwPath(const char* lib) {
 HidlInstrumentor::HidlInstrumentor(const std::string& package, const std::string& interface)
     : mEnableInstrumentation(false),
       mInstrumentationLibPackage(package),
-      mInterfaceName(interface) {}
+      mInterfaceName(interface) {
+    // Objects created while the call watchdog runs report their calls to it.
+    if (configureCallWatchdog()) configureInstrumentation(false);
+}
 
 HidlInstrumentor::~HidlInstrumentor() {}
 
 void HidlInstrumentor::configureInstrumentation(bool log) {
-    mEnableInstrumentation = base::GetBoolProperty("hal.instrumentation.enable", false);
+    // The call watchdog is fed by instrumentation events, so it turns them on too.
+    mEnableInstrumentation = base::GetBoolProperty("hal.instrumentation.enable", false) ||
+                             configureCallWatchdog();
     if (mEnableInstrumentation) {
         if (log) {
             LOG(INFO) << "Enable instrumentation.";
@@ -72,9 +78,14 @@ void HidlInstrumentor::configureInstrumentation(bool log) {
 
 void HidlInstrumentor::registerInstrumentationCallbacks(
         std::vector<InstrumentationCallback> *instrumentationCallbacks) {
-    // No-op, historical
-    (void) instrumentationCallbacks;
-    return;
+    // Loading instrumentation libraries is historical. Only the call watchdog remains.
+    if (isCallWatchdogEnabled()) {
+        instrumentationCallbacks->push_back(
+                [](const InstrumentationEvent event, const char* package, const char* version,
+                   const char* interface, const char* method, std::vector<void*>*) {
+                    onCallWatchdogEvent(event, package, version, interface, method);
+                });
+    }
 }
 
 bool HidlInstrumentor::isInstrumentationLib(const dirent *file) {
@@ -16,6 +16,7 @@
 #define LOG_TAG "HidlSupport"
 
 #include <hidl/HidlSupport.h>
+#include <hidl/ResourceAccounting.h>
 
 #include <unordered_map>
 
@@ -35,6 +36,19 @@ bool debuggable() {
 }
 }  // namespace details
 
+using details::accountResourceAcquired;
+using details::accountResourceReleased;
+using details::SharedResource;
+
+static native_handle_t* cloneHandle(const native_handle_t* handle, const void* site) {
+    native_handle_t* clone = native_handle_clone(handle);
+    if (clone == nullptr) {
+        PLOG(FATAL) << "Failed to clone native_handle in hidl_handle";
+    }
+    accountResourceAcquired(SharedResource::HANDLE, clone, clone->numFds, site);
+    return clone;
+}
+
 hidl_handle::hidl_handle() : mHandle(nullptr), mOwnsHandle(false) {
     memset(mPad, 0, sizeof(mPad));
 }
@@ -50,8 +64,10 @@ hidl_handle::hidl_handle(const native_handle_t* handle) : hidl_handle() {
 
 // copy constructor.
 hidl_handle::hidl_handle(const hidl_handle& other) : hidl_handle() {
-    mOwnsHandle = false;
-    *this = other;
+    if (other.mHandle != nullptr) {
+        mHandle = cloneHandle(other.mHandle, __builtin_return_address(0));
+        mOwnsHandle = true;
+    }
 }
 
 // move constructor.
@@ -67,10 +83,7 @@ hidl_handle &hidl_handle::operator=(const hidl_handle &other) {
     }
     freeHandle();
     if (other.mHandle != nullptr) {
-        mHandle = native_handle_clone(other.mHandle);
-        if (mHandle == nullptr) {
-            PLOG(FATAL) << "Failed to clone native_handle in hidl_handle";
-        }
+        mHandle = cloneHandle(other.mHandle, __builtin_return_address(0));
         mOwnsHandle = true;
     } else {
         mHandle = nullptr;
@@ -101,6 +114,10 @@ void hidl_handle::setTo(native_handle_t* handle, bool shouldOwn) {
     freeHandle();
     mHandle = handle;
     mOwnsHandle = shouldOwn;
+    if (shouldOwn && handle != nullptr) {
+        accountResourceAcquired(SharedResource::HANDLE, handle, handle->numFds,
+                                __builtin_return_address(0));
+    }
 }
 
 const native_handle_t* hidl_handle::operator->() const {
@@ -128,6 +145,7 @@ void hidl_handle::freeHandle() {
         //    hidl_handle must have been non-const as well.
         native_handle_t *handle = const_cast<native_handle_t*>(
                 static_cast<const native_handle_t*>(mHandle));
+        accountResourceReleased(SharedResource::HANDLE, handle);
         native_handle_close(handle);
         native_handle_delete(handle);
         mHandle = nullptr;
@@ -211,6 +229,91 @@ std::ostream& operator<<(std::ostream& os, const hidl_string& str) {
     return os;
 }
 
+// Decodes the UTF-8 sequence starting with the non-ASCII byte at data[*index], advancing *index
+// past it. Returns false if the sequence is ill-formed, in which case only the lead byte is
+// consumed.
+static bool decodeUtf8Sequence(const uint8_t* data, size_t size, size_t* index) {
+    uint8_t lead = data[*index];
+    size_t continuations;
+    uint8_t low = 0x80;
+    uint8_t high = 0xBF;
+
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        continuations = 1;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        continuations = 2;
+        if (lead == 0xE0) low = 0xA0;  // overlong
+        if (lead == 0xED) high = 0x9F;  // surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        continuations = 3;
+        if (lead == 0xF0) low = 0x90;  // overlong
+        if (lead == 0xF4) high = 0x8F;  // above U+10FFFF
+    } else {
+        ++*index;
+        return false;
+    }
+
+    if (size - *index <= continuations) {
+        ++*index;
+        return false;
+    }
+    for (size_t i = 1; i <= continuations; ++i) {
+        uint8_t c = data[*index + i];
+        if (c < low || c > high) {
+            ++*index;
+            return false;
+        }
+        low = 0x80;
+        high = 0xBF;
+    }
+
+    *index += continuations + 1;
+    return true;
+}
+
+hidl_string_validation validateHidlString(const char* data, size_t size) {
+    typedef uint8_t u8x16 __attribute__((vector_size(16)));
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    hidl_string_validation result;
+
+    size_t i = 0;
+    while (i < size) {
+        if (size - i >= sizeof(u8x16)) {
+            u8x16 block;
+            memcpy(&block, bytes + i, sizeof(block));
+
+            // Both '\0' and bytes >= 0x80 wrap to >= 0x7F.
+            auto special = (block - 1) >= 0x7F;
+            uint64_t lanes[2];
+            memcpy(lanes, &special, sizeof(lanes));
+            if ((lanes[0] | lanes[1]) == 0) {
+                i += sizeof(u8x16);
+                continue;
+            }
+        }
+
+        // Decode until the end of this block, or further if a sequence crosses it.
+        size_t end = std::min(size, i + sizeof(u8x16));
+        while (i < end) {
+            uint8_t c = bytes[i];
+            if (c == '\0') {
+                result.hasEmbeddedNul = true;
+                ++i;
+            } else if (c < 0x80) {
+                ++i;
+            } else {
+                result.isAscii = false;
+                if (!decodeUtf8Sequence(bytes, size, &i)) {
+                    result.isUtf8 = false;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 void hidl_string::copyFrom(const char *data, size_t size) {
     // assume my resources are freed.
 
@@ -286,15 +389,115 @@ bool hidl_string::empty() const {
     return mSize == 0;
 }
 
+template <typename Strings, typename GetData, typename GetSize>
+static void packStrings(const Strings& strings, GetData getData, GetSize getSize,
+                        hidl_vec<char>* chars, hidl_vec<uint32_t>* offsets) {
+    size_t total = 0;
+    for (const auto& string : strings) {
+        total += getSize(string) + 1;
+    }
+    if (total > UINT32_MAX) {
+        LOG(FATAL) << "string list size can't exceed 2^32 bytes: " << total;
+    }
+
+    chars->resize(total);
+    offsets->resize(strings.size());
+
+    size_t index = 0;
+    uint32_t offset = 0;
+    for (const auto& string : strings) {
+        size_t size = getSize(string);
+        (*offsets)[index++] = offset;
+        memcpy(chars->data() + offset, getData(string), size);
+        (*chars)[offset + size] = '\0';
+        offset += static_cast<uint32_t>(size + 1);
+    }
+}
+
+hidl_string_list::hidl_string_list(const hidl_vec<hidl_string>& strings) {
+    packStrings(
+            strings, [](const hidl_string& s) { return s.c_str(); },
+            [](const hidl_string& s) { return s.size(); }, &mChars, &mOffsets);
+}
+
+hidl_string_list::hidl_string_list(const std::vector<std::string>& strings) {
+    packStrings(
+            strings, [](const std::string& s) { return s.c_str(); },
+            [](const std::string& s) { return s.size(); }, &mChars, &mOffsets);
+}
+
+hidl_string_list::hidl_string_list(std::initializer_list<const char*> strings) {
+    packStrings(
+            strings, [](const char* s) { return s; }, [](const char* s) { return strlen(s); },
+            &mChars, &mOffsets);
+}
+
+hidl_string hidl_string_list::operator[](size_t index) const {
+    size_t begin = mOffsets[index];
+    size_t end = index + 1 < mOffsets.size() ? mOffsets[index + 1] : mChars.size();
+
+    hidl_string view;
+    view.setToExternal(mChars.data() + begin, end - begin - 1);
+    return view;
+}
+
+hidl_vec<hidl_string> hidl_string_list::views() const {
+    hidl_vec<hidl_string> views;
+    views.resize(size());
+    for (size_t i = 0; i < size(); ++i) {
+        views[i] = (*this)[i];
+    }
+    return views;
+}
+
+hidl_string_list::operator std::vector<std::string>() const {
+    std::vector<std::string> strings;
+    strings.reserve(size());
+    for (size_t i = 0; i < size(); ++i) {
+        hidl_string view = (*this)[i];
+        strings.emplace_back(view.c_str(), view.size());
+    }
+    return strings;
+}
+
+bool hidl_string_list::isValid() const {
+    if (mOffsets.size() == 0) {
+        return mChars.size() == 0;
+    }
+    if (mChars.size() == 0 || mChars.size() > UINT32_MAX || mOffsets[0] != 0 ||
+        mChars[mChars.size() - 1] != '\0') {
+        return false;
+    }
+    for (size_t i = 1; i < mOffsets.size(); ++i) {
+        // Each string, even an empty one, takes at least its terminator.
+        if (mOffsets[i] <= mOffsets[i - 1] || mOffsets[i] >= mChars.size() ||
+            mChars[mOffsets[i] - 1] != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool operator==(const hidl_string_list& list1, const hidl_string_list& list2) {
+    return list1.chars() == list2.chars() && list1.offsets() == list2.offsets();
+}
+
+static void accountMemory(const sp<HidlMemory>& memory, const void* site) {
+    accountResourceAcquired(SharedResource::HIDL_MEMORY, memory.get(), memory->size(), site,
+                            memory->name().c_str());
+}
+
 sp<HidlMemory> HidlMemory::getInstance(const hidl_memory& mem) {
     sp<HidlMemory> instance = new HidlMemory();
     instance->hidl_memory::operator=(mem);
+    accountMemory(instance, __builtin_return_address(0));
     return instance;
 }
 
 sp<HidlMemory> HidlMemory::getInstance(hidl_memory&& mem) {
     sp<HidlMemory> instance = new HidlMemory();
     instance->hidl_memory::operator=(std::move(mem));
+    accountMemory(instance, __builtin_return_address(0));
     return instance;
 }
 
@@ -311,6 +514,7 @@ sp<HidlMemory> HidlMemory::getInstance(const hidl_string& name, int fd, uint64_t
     hidlHandle.setTo(handle, true /* shouldOwn */);
 
     sp<HidlMemory> instance = new HidlMemory(name, std::move(hidlHandle), size);
+    accountMemory(instance, __builtin_return_address(0));
     return instance;
 }
 
@@ -320,7 +524,9 @@ HidlMemory::HidlMemory(const hidl_string& name, hidl_handle&& handle, size_t siz
         : hidl_memory(name, std::move(handle), size) {}
 
 // it's required to have at least one out-of-line method to avoid weak vtable
-HidlMemory::~HidlMemory() {}
+HidlMemory::~HidlMemory() {
+    accountResourceReleased(SharedResource::HIDL_MEMORY, this);
+}
 
 }  // namespace hardware
 }  // namespace android
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HidlResourceAccounting"
+
+#include <hidl/ResourceAccounting.h>
+
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+using base::StringPrintf;
+
+static std::atomic<bool>& enabledFlag() {
+    static std::atomic<bool>& enabled = *new std::atomic<bool>(
+            base::GetBoolProperty("hidl.resource_accounting.enable", false));
+    return enabled;
+}
+
+// Resources being tracked, so that releasing is cheap when there are none.
+static std::atomic<size_t> gTracked{0};
+
+namespace {
+
+struct SiteKey {
+    SharedResource type;
+    const void* site;
+    std::string name;
+
+    bool operator<(const SiteKey& other) const {
+        return std::tie(type, site, name) < std::tie(other.type, other.site, other.name);
+    }
+};
+
+struct Usage {
+    size_t count = 0;
+    uint64_t amount = 0;
+};
+
+struct Tracked {
+    std::map<SiteKey, Usage>::iterator usage;
+    uint64_t amount;
+};
+
+struct Accounting {
+    std::mutex mutex;
+    std::map<SiteKey, Usage> usage;
+    std::map<std::pair<SharedResource, const void*>, Tracked> tracked;
+
+    // must hold mutex
+    void release(std::map<std::pair<SharedResource, const void*>, Tracked>::iterator it) {
+        Usage& counted = it->second.usage->second;
+        counted.count--;
+        counted.amount -= it->second.amount;
+        if (counted.count == 0) usage.erase(it->second.usage);
+        tracked.erase(it);
+        gTracked--;
+    }
+};
+
+}  // namespace
+
+static Accounting& accounting() {
+    static Accounting& accounting = *new Accounting;
+    return accounting;
+}
+
+void setResourceAccountingEnabled(bool enabled) {
+    enabledFlag().store(enabled, std::memory_order_relaxed);
+}
+
+bool isResourceAccountingEnabled() {
+    return enabledFlag().load(std::memory_order_relaxed);
+}
+
+void accountResourceAcquired(SharedResource type, const void* resource, uint64_t amount,
+                             const void* site, const char* name) {
+    if (resource == nullptr || !isResourceAccountingEnabled()) return;
+
+    Accounting& a = accounting();
+    std::lock_guard<std::mutex> lock(a.mutex);
+
+    // A resource may be reused without its release having been seen, e.x. if it was released
+    // by code which does not account for it.
+    auto old = a.tracked.find({type, resource});
+    if (old != a.tracked.end()) a.release(old);
+
+    auto usage = a.usage.emplace(SiteKey{type, site, name == nullptr ? "" : name}, Usage{}).first;
+    usage->second.count++;
+    usage->second.amount += amount;
+    a.tracked.emplace(std::make_pair(type, resource), Tracked{usage, amount});
+    gTracked++;
+}
+
+__attribute__((noinline)) void accountResourceAcquiredHere(SharedResource type,
+                                                           const void* resource, uint64_t amount,
+                                                           const char* name) {
+    accountResourceAcquired(type, resource, amount, __builtin_return_address(0), name);
+}
+
+void accountResourceReleased(SharedResource type, const void* resource) {
+    if (resource == nullptr || gTracked.load(std::memory_order_relaxed) == 0) return;
+
+    Accounting& a = accounting();
+    std::lock_guard<std::mutex> lock(a.mutex);
+    auto it = a.tracked.find({type, resource});
+    if (it != a.tracked.end()) a.release(it);
+}
+
+static std::string describeSite(const void* site) {
+    Dl_info info;
+    if (site == nullptr || dladdr(site, &info) == 0 || info.dli_fname == nullptr) {
+        return StringPrintf("%p", site);
+    }
+
+    const char* library = strrchr(info.dli_fname, '/');
+    library = library == nullptr ? info.dli_fname : library + 1;
+    uintptr_t address = reinterpret_cast<uintptr_t>(site);
+    std::string description = StringPrintf(
+            "%s+0x%" PRIxPTR, library, address - reinterpret_cast<uintptr_t>(info.dli_fbase));
+    if (info.dli_sname != nullptr) {
+        description += StringPrintf(" (%s+0x%" PRIxPTR ")", info.dli_sname,
+                                    address - reinterpret_cast<uintptr_t>(info.dli_saddr));
+    }
+    return description;
+}
+
+static const char* typeName(SharedResource type) {
+    switch (type) {
+        case SharedResource::HANDLE:
+            return "hidl_handle";
+        case SharedResource::HIDL_MEMORY:
+            return "HidlMemory";
+        case SharedResource::ASHMEM_MAPPING:
+            return "ashmem mapping";
+        case SharedResource::MQ_DESCRIPTOR:
+            return "MQDescriptor";
+    }
+    return "unknown";
+}
+
+static const char* unitName(SharedResource type) {
+    switch (type) {
+        case SharedResource::HANDLE:
+        case SharedResource::MQ_DESCRIPTOR:
+            return "fds";
+        case SharedResource::HIDL_MEMORY:
+        case SharedResource::ASHMEM_MAPPING:
+            return "bytes";
+    }
+    return "";
+}
+
+std::vector<SharedResourceUsage> getSharedResourceUsage() {
+    std::vector<std::pair<SiteKey, Usage>> usages;
+    {
+        Accounting& a = accounting();
+        std::lock_guard<std::mutex> lock(a.mutex);
+        usages.assign(a.usage.begin(), a.usage.end());
+    }
+
+    // symbolized without the lock, since dladdr may be slow
+    std::vector<SharedResourceUsage> result;
+    result.reserve(usages.size());
+    for (const auto& [key, usage] : usages) {
+        result.push_back({key.type, describeSite(key.site), key.name, usage.count, usage.amount});
+    }
+    std::stable_sort(result.begin(), result.end(),
+                     [](const SharedResourceUsage& a, const SharedResourceUsage& b) {
+                         return a.type != b.type ? a.type < b.type : a.amount > b.amount;
+                     });
+    return result;
+}
+
+void dumpSharedResourceUsage(int fd) {
+    std::string out = StringPrintf("%-16s %8s %14s %-6s %-16s %s\n", "type", "count", "amount",
+                                   "", "name", "site");
+    for (const SharedResourceUsage& usage : getSharedResourceUsage()) {
+        out += StringPrintf("%-16s %8zu %14" PRIu64 " %-6s %-16s %s\n", typeName(usage.type),
+                            usage.count, usage.amount, unitName(usage.type), usage.name.c_str(),
+                            usage.site.c_str());
+    }
+    if (!isResourceAccountingEnabled()) {
+        out += "(resource accounting is disabled)\n";
+    }
+    base::WriteStringToFd(out, fd);
+}
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HIDL_CALL_WATCHDOG_H
+#define ANDROID_HIDL_CALL_WATCHDOG_H
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include <hidl/HidlInternal.h>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+/**
+ * Optional watchdog for HIDL calls which do not return, e.x. a HAL call blocking a framework
+ * thread. It tracks the calls in flight on each thread through HidlInstrumentor's entry and exit
+ * events, and a watchdog thread reports each call which outlives its timeout once, along with the
+ * stack of the thread making it. Tracking a call takes no locks.
+ *
+ * It is off unless started with startCallWatchdog or the hidl.watchdog.timeout_ms property.
+ * Interface objects only report events if they were created while it was running, and generated
+ * code only reports events on debuggable builds.
+ */
+struct HungCall {
+    std::string descriptor;  // e.x. android.hardware.foo@1.0::IFoo::bar
+    // how the call was entered, e.x. CLIENT_API_ENTRY
+    HidlInstrumentor::InstrumentationEvent event;
+    pid_t tid;
+    std::chrono::milliseconds elapsed;
+    std::string stack;
+};
+using HungCallHandler = std::function<void(const HungCall& call)>;
+
+// Starts the watchdog, or changes its default timeout and handler. Without a handler, hung calls
+// are logged.
+void startCallWatchdog(std::chrono::milliseconds timeout, HungCallHandler handler = nullptr);
+// Stops reporting calls and tracking new ones.
+void stopCallWatchdog();
+bool isCallWatchdogEnabled();
+
+// Overrides the timeout for calls to interface, e.x. "android.hardware.foo@1.0::IFoo".
+void setCallWatchdogTimeout(const std::string& interface, std::chrono::milliseconds timeout);
+
+// Starts the watchdog from hidl.watchdog.timeout_ms the first time it is called. Returns whether
+// it is running. Used by HidlInstrumentor.
+bool configureCallWatchdog();
+
+// The instrumentation callback, which records the entry and exit of calls on this thread.
+void onCallWatchdogEvent(HidlInstrumentor::InstrumentationEvent event, const char* package,
+                         const char* version, const char* interface, const char* method);
+
+// Forgets the calls this thread is making, since not all calls report their exit, for when it is
+// known not to be making any, e.x. when it joins the RPC thread pool.
+void resetCallWatchdogThread();
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HIDL_CALL_WATCHDOG_H
@@ -22,6 +22,8 @@
 #include <iterator>
 #include <hidl/HidlInternal.h>
 #include <map>
+#include <memory>
+#include <new>
 #include <sstream>
 #include <stddef.h>
 #include <tuple>
@@ -214,6 +216,24 @@ HIDL_STRING_OPERATOR(>=)
 // Send our content to the output stream
 std::ostream& operator<<(std::ostream& os, const hidl_string& str);
 
+// Properties of a string's contents, computed in a single pass by validateHidlString. Keep the
+// result next to the string rather than rescanning it for each check.
+struct hidl_string_validation {
+    // false if any byte is 0x80 or above.
+    bool isAscii = true;
+    // true if a '\0' occurs before the end of the string.
+    bool hasEmbeddedNul = false;
+    // false if the string is not well-formed UTF-8 (overlong forms, surrogates and code points
+    // above U+10FFFF are ill-formed). An embedded '\0' is well-formed UTF-8.
+    bool isUtf8 = true;
+};
+
+// Scans 16 bytes at a time, and only decodes the blocks which are not plain ASCII.
+hidl_string_validation validateHidlString(const char* data, size_t size);
+inline hidl_string_validation validateHidlString(const hidl_string& string) {
+    return validateHidlString(string.c_str(), string.size());
+}
+
 
 // hidl_memory is a structure that can be used to transfer
 // pieces of shared memory between processes. The assumption
@@ -604,6 +624,200 @@ public:
 template <typename T>
 const size_t hidl_vec<T>::kOffsetOfBuffer = offsetof(hidl_vec<T>, mBuffer);
 
+// A list of strings packed into one character buffer plus an offset table. Unlike
+// hidl_vec<hidl_string>, which sends every string as its own embedded buffer, this is sent as
+// two embedded buffers no matter how many strings it holds. On the wire it is the same as
+//
+//     struct StringList {
+//         vec<int8_t> chars;     // the strings, each terminated by '\0'
+//         vec<uint32_t> offsets; // offset of each string in chars
+//     };
+//
+// Strings are returned as hidl_string views into the list, so they are only valid for the
+// lifetime of the list (or of the Parcel it was read from).
+struct hidl_string_list {
+    hidl_string_list() = default;
+    hidl_string_list(const hidl_vec<hidl_string>& strings);
+    hidl_string_list(const std::vector<std::string>& strings);
+    hidl_string_list(std::initializer_list<const char*> strings);
+
+    size_t size() const { return mOffsets.size(); }
+    bool empty() const { return mOffsets.size() == 0; }
+
+    // A non-owning view of the index-th string.
+    hidl_string operator[](size_t index) const;
+
+    // Views of all strings.
+    hidl_vec<hidl_string> views() const;
+    // Copies of all strings.
+    operator std::vector<std::string>() const;
+
+    // Total size of the packed strings, including their terminators.
+    size_t packedSize() const { return mChars.size(); }
+
+    // Checks that the offset table and terminators are consistent, as they are when received
+    // from another process.
+    bool isValid() const;
+
+    // offsetof(hidl_string_list, mChars) and offsetof(hidl_string_list, mOffsets) exposed since
+    // they are private.
+    static const size_t kOffsetOfChars;
+    static const size_t kOffsetOfOffsets;
+
+    // Wire representation, for use by parceling code.
+    const hidl_vec<char>& chars() const { return mChars; }
+    const hidl_vec<uint32_t>& offsets() const { return mOffsets; }
+
+   private:
+    hidl_vec<char> mChars;
+    hidl_vec<uint32_t> mOffsets;
+};
+
+bool operator==(const hidl_string_list& list1, const hidl_string_list& list2);
+inline bool operator!=(const hidl_string_list& list1, const hidl_string_list& list2) {
+    return !(list1 == list2);
+}
+
+namespace details {
+
+// How hidl_flat_copy places the contents of one element of the outer vector.
+template <typename T>
+struct flat_copy_traits;
+
+template <>
+struct flat_copy_traits<hidl_string> {
+    static constexpr size_t kAlignment = 1;
+
+    static size_t footprint(const hidl_string& string) { return string.size() + 1; }
+
+    static void place(hidl_string* dest, const hidl_string& src, uint8_t* storage) {
+        memcpy(storage, src.c_str(), src.size() + 1);
+        dest->setToExternal(reinterpret_cast<const char*>(storage), src.size());
+    }
+};
+
+template <typename T>
+struct flat_copy_traits<hidl_vec<T>> {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "hidl_flat_copy only supports vectors of trivially copyable types");
+
+    static constexpr size_t kAlignment = alignof(T);
+
+    static size_t footprint(const hidl_vec<T>& vec) { return vec.size() * sizeof(T); }
+
+    static void place(hidl_vec<T>* dest, const hidl_vec<T>& src, uint8_t* storage) {
+        if (src.size() > 0) {
+            memcpy(storage, src.data(), src.size() * sizeof(T));
+        }
+        dest->setToExternal(reinterpret_cast<T*>(storage), src.size());
+    }
+};
+
+}  // namespace details
+
+// A read-only deep copy of a vec<string> or vec<vec<T>> (T trivially copyable) which makes a
+// single allocation. Copying the hidl_vec itself allocates once per inner element; this instead
+// computes the total footprint, places the outer elements and all inner buffers in one block,
+// and points the inner elements at it with setToExternal.
+//
+// The copy owns the block, so references obtained through get() are only valid for its
+// lifetime. Inner elements must not be resized or reassigned.
+template <typename T>
+class hidl_flat_copy {
+    using traits = details::flat_copy_traits<T>;
+    static_assert(traits::kAlignment <= alignof(std::max_align_t), "unsupported alignment");
+
+   public:
+    hidl_flat_copy() = default;
+    explicit hidl_flat_copy(const hidl_vec<T>& other) { copyFrom(other); }
+
+    hidl_flat_copy(const hidl_flat_copy& other) { copyFrom(other.mVec); }
+    hidl_flat_copy(hidl_flat_copy&& other) noexcept { moveFrom(std::move(other)); }
+
+    hidl_flat_copy& operator=(const hidl_flat_copy& other) {
+        if (this != &other) {
+            clear();
+            copyFrom(other.mVec);
+        }
+        return *this;
+    }
+
+    hidl_flat_copy& operator=(hidl_flat_copy&& other) noexcept {
+        if (this != &other) {
+            clear();
+            moveFrom(std::move(other));
+        }
+        return *this;
+    }
+
+    ~hidl_flat_copy() { clear(); }
+
+    const hidl_vec<T>& get() const { return mVec; }
+    operator const hidl_vec<T>&() const { return mVec; }
+
+    size_t size() const { return mVec.size(); }
+    const T& operator[](size_t index) const { return mVec[index]; }
+
+    // Size in bytes of the single allocation backing the copy.
+    size_t footprint() const { return mFootprint; }
+
+   private:
+    static size_t align(size_t offset) {
+        return (offset + traits::kAlignment - 1) & ~(traits::kAlignment - 1);
+    }
+
+    // assumes my resources are freed.
+    void copyFrom(const hidl_vec<T>& other) {
+        if (other.size() == 0) {
+            return;
+        }
+
+        size_t footprint = other.size() * sizeof(T);
+        for (const T& element : other) {
+            footprint = align(footprint) + traits::footprint(element);
+        }
+
+        mBlock.reset(new uint8_t[footprint]);
+        mFootprint = footprint;
+
+        T* elements = reinterpret_cast<T*>(mBlock.get());
+        size_t offset = other.size() * sizeof(T);
+        for (size_t i = 0; i < other.size(); ++i) {
+            new (&elements[i]) T();
+            offset = align(offset);
+            traits::place(&elements[i], other[i], mBlock.get() + offset);
+            offset += traits::footprint(other[i]);
+        }
+
+        mVec.setToExternal(elements, other.size());
+    }
+
+    // assumes my resources are freed.
+    void moveFrom(hidl_flat_copy&& other) {
+        mBlock = std::move(other.mBlock);
+        mFootprint = other.mFootprint;
+        mVec = std::move(other.mVec);
+
+        other.mFootprint = 0;
+        other.mVec = hidl_vec<T>();
+    }
+
+    void clear() {
+        if (mBlock != nullptr) {
+            for (size_t i = 0; i < mVec.size(); ++i) {
+                mVec[i].~T();
+            }
+        }
+        mVec = hidl_vec<T>();
+        mBlock.reset();
+        mFootprint = 0;
+    }
+
+    std::unique_ptr<uint8_t[]> mBlock;
+    size_t mFootprint = 0;
+    hidl_vec<T> mVec;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 
 namespace details {
@@ -867,6 +1081,60 @@ private:
     T mBuffer[SIZE1];
 };
 
+// The interface and hash chains of an interface never change, so interfaceChain and getHashChain
+// can build them once and hand the same vec to every callback, without allocating:
+//
+//     static const hidl_interface_chain<2> chain({IFoo::descriptor, IBase::descriptor});
+//     _hidl_cb(chain);
+//
+// The elements refer to the given descriptors with setToExternal, so those must outlive the
+// chain (as the static descriptor members of interfaces do). Chains refer to their own storage,
+// so they can be neither copied nor moved.
+template <size_t N>
+class hidl_interface_chain {
+   public:
+    explicit hidl_interface_chain(const char* const (&descriptors)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            mDescriptors[i].setToExternal(descriptors[i], strlen(descriptors[i]));
+        }
+        mVec.setToExternal(mDescriptors, N);
+    }
+
+    hidl_interface_chain(const hidl_interface_chain&) = delete;
+    hidl_interface_chain& operator=(const hidl_interface_chain&) = delete;
+
+    const hidl_vec<hidl_string>& get() const { return mVec; }
+    operator const hidl_vec<hidl_string>&() const { return mVec; }
+
+   private:
+    hidl_string mDescriptors[N];
+    hidl_vec<hidl_string> mVec;
+};
+
+// Same as hidl_interface_chain, for getHashChain. The hashes are copied in.
+template <size_t N>
+class hidl_hash_chain {
+   public:
+    using hash_type = hidl_array<uint8_t, 32>;
+
+    explicit hidl_hash_chain(const uint8_t (&hashes)[N][32]) {
+        for (size_t i = 0; i < N; ++i) {
+            mHashes[i] = hash_type(hashes[i]);
+        }
+        mVec.setToExternal(mHashes, N);
+    }
+
+    hidl_hash_chain(const hidl_hash_chain&) = delete;
+    hidl_hash_chain& operator=(const hidl_hash_chain&) = delete;
+
+    const hidl_vec<hash_type>& get() const { return mVec; }
+    operator const hidl_vec<hash_type>&() const { return mVec; }
+
+   private:
+    hash_type mHashes[N];
+    hidl_vec<hash_type> mVec;
+};
+
 // ----------------------------------------------------------------------
 // Version functions
 struct hidl_version {
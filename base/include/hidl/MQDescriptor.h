@@ -23,6 +23,7 @@
 #include <fmq/MQDescriptorBase.h>
 #include <hidl/HidlInternal.h>
 #include <hidl/HidlSupport.h>
+#include <hidl/ResourceAccounting.h>
 
 namespace android {
 namespace hardware {
@@ -99,6 +100,10 @@ template <typename T, MQFlavor flavor>
 MQDescriptor<T, flavor>::MQDescriptor(const std::vector<GrantorDescriptor>& grantors,
                                       native_handle_t* nhandle, size_t size)
     : mHandle(nhandle), mQuantum(static_cast<uint32_t>(size)), mFlags(flavor) {
+    if (nhandle != nullptr) {
+        details::accountResourceAcquiredHere(details::SharedResource::MQ_DESCRIPTOR, nhandle,
+                                             nhandle->numFds);
+    }
     mGrantors.resize(grantors.size());
     for (size_t i = 0; i < grantors.size(); ++i) {
         mGrantors[i] = grantors[i];
@@ -109,6 +114,10 @@ template <typename T, MQFlavor flavor>
 MQDescriptor<T, flavor>::MQDescriptor(size_t bufferSize, native_handle_t* nHandle,
                                       size_t messageSize, bool configureEventFlag)
     : mHandle(nHandle), mQuantum(static_cast<uint32_t>(messageSize)), mFlags(flavor) {
+    if (nHandle != nullptr) {
+        details::accountResourceAcquiredHere(details::SharedResource::MQ_DESCRIPTOR, nHandle,
+                                             nHandle->numFds);
+    }
     /*
      * If configureEventFlag is true, allocate an additional spot in mGrantor
      * for containing the fd and offset for mmapping the EventFlag word.
@@ -143,6 +152,7 @@ template <typename T, MQFlavor flavor>
 MQDescriptor<T, flavor>& MQDescriptor<T, flavor>::operator=(const MQDescriptor& other) {
     mGrantors = other.mGrantors;
     if (mHandle != nullptr) {
+        details::accountResourceReleased(details::SharedResource::MQ_DESCRIPTOR, mHandle);
         native_handle_close(mHandle);
         native_handle_delete(mHandle);
         mHandle = nullptr;
@@ -160,6 +170,8 @@ MQDescriptor<T, flavor>& MQDescriptor<T, flavor>::operator=(const MQDescriptor&
 
         memcpy(&mHandle->data[other.mHandle->numFds], &other.mHandle->data[other.mHandle->numFds],
                static_cast<size_t>(other.mHandle->numInts) * sizeof(int));
+        details::accountResourceAcquiredHere(details::SharedResource::MQ_DESCRIPTOR, mHandle,
+                                             mHandle->numFds);
     }
 
     return *this;
@@ -174,6 +186,7 @@ MQDescriptor<T, flavor>::MQDescriptor() : MQDescriptor(
 template<typename T, MQFlavor flavor>
 MQDescriptor<T, flavor>::~MQDescriptor() {
     if (mHandle != nullptr) {
+        details::accountResourceReleased(details::SharedResource::MQ_DESCRIPTOR, mHandle);
         native_handle_close(mHandle);
         native_handle_delete(mHandle);
     }
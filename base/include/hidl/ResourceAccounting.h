@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HIDL_RESOURCE_ACCOUNTING_H
+#define ANDROID_HIDL_RESOURCE_ACCOUNTING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+/**
+ * Optional accounting of the fds and shared memory held through HIDL types, for finding leaks.
+ * It is off unless enabled with setResourceAccountingEnabled or the
+ * hidl.resource_accounting.enable property, and only counts resources acquired while it is on.
+ * While it is off, accounting a resource costs an atomic load.
+ */
+enum class SharedResource : uint8_t {
+    HANDLE,          // native_handle_t owned by a hidl_handle, amount is fds
+    HIDL_MEMORY,     // HidlMemory, amount is bytes
+    ASHMEM_MAPPING,  // mapping made by the ashmem IMapper, amount is bytes
+    MQ_DESCRIPTOR,   // native_handle_t owned by an MQDescriptor, amount is fds
+};
+
+void setResourceAccountingEnabled(bool enabled);
+bool isResourceAccountingEnabled();
+
+// Records that resource was acquired by the code at site (usually __builtin_return_address(0)).
+// name distinguishes resources of the same site, e.x. the name of a hidl_memory.
+void accountResourceAcquired(SharedResource type, const void* resource, uint64_t amount,
+                             const void* site, const char* name = "");
+// Same as above, with the site being the code which calls this. For code in headers, e.x.
+// MQDescriptor, where __builtin_return_address(0) is the caller's caller once it is inlined. If
+// it is not inlined, the site is the function in the header instead of its caller.
+void accountResourceAcquiredHere(SharedResource type, const void* resource, uint64_t amount,
+                                 const char* name = "");
+// Records that resource was released. Resources which were not accounted are ignored.
+void accountResourceReleased(SharedResource type, const void* resource);
+
+struct SharedResourceUsage {
+    SharedResource type;
+    std::string site;  // e.x. libfoo.so+0x1234 (Foo::bar()+0x10)
+    std::string name;
+    size_t count;     // live resources
+    uint64_t amount;  // sum of their amounts
+};
+
+// Live resources by type, creation site and name, largest amounts first.
+std::vector<SharedResourceUsage> getSharedResourceUsage();
+
+// Writes getSharedResourceUsage() as a table to fd, e.x. from IBase::debug.
+void dumpSharedResourceUsage(int fd);
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HIDL_RESOURCE_ACCOUNTING_H
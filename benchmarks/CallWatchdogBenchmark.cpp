@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost the call watchdog adds to each HIDL call, i.e. to an entry and an exit event.
+
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+#include <hidl/CallWatchdog.h>
+
+using android::hardware::details::HidlInstrumentor;
+using android::hardware::details::onCallWatchdogEvent;
+using android::hardware::details::startCallWatchdog;
+using android::hardware::details::stopCallWatchdog;
+
+static void BM_CallWatchdogEvents(benchmark::State& state) {
+    bool enabled = state.range(0) != 0;
+    if (enabled) startCallWatchdog(std::chrono::hours(1));
+
+    for (auto _ : state) {
+        onCallWatchdogEvent(HidlInstrumentor::CLIENT_API_ENTRY, "android.hardware.benchmark",
+                            "1.0", "IBenchmark", "call");
+        onCallWatchdogEvent(HidlInstrumentor::CLIENT_API_EXIT, "android.hardware.benchmark",
+                            "1.0", "IBenchmark", "call");
+    }
+
+    if (enabled) stopCallWatchdog();
+}
+BENCHMARK(BM_CallWatchdogEvents)->Arg(0)->Arg(1);
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of the transport's shared state under contention. The invariants are checked by the
+// *StressTest cases in libhidl_test; these fail the benchmark if they are broken too.
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+#include <hidl/ConcurrentMap.h>
+#include <hidl/HidlBinderSupport.h>
+#include <hidl/Static.h>
+#include <hidl/TaskRunner.h>
+
+using android::sp;
+using android::hardware::BHwBinder;
+using android::hardware::ConcurrentMap;
+using android::hardware::getOrCreateCachedBinder;
+using android::hardware::IBinder;
+using android::hardware::Return;
+using android::hardware::Void;
+using android::hardware::details::gBnMap;
+using android::hardware::details::getBnConstructorMap;
+using android::hardware::details::TaskRunner;
+using android::hidl::base::V1_0::IBase;
+
+static constexpr size_t kKeys = 64;
+
+static ConcurrentMap<size_t, size_t>& sharedMap() {
+    static ConcurrentMap<size_t, size_t>* map = [] {
+        auto* map = new ConcurrentMap<size_t, size_t>();
+        for (size_t key = 0; key < kKeys; ++key) map->set(size_t(key), key * 10);
+        return map;
+    }();
+    return *map;
+}
+
+static void BM_ConcurrentMap_Get(benchmark::State& state) {
+    ConcurrentMap<size_t, size_t>& map = sharedMap();
+    size_t key = state.thread_index();
+
+    for (auto _ : state) {
+        key = (key + 1) % kKeys;
+        std::unique_lock<std::mutex> lock = map.lock();
+        if (map.getLocked(key, 0) != key * 10) {
+            state.SkipWithError("torn read");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_ConcurrentMap_Get)->ThreadRange(1, 16)->UseRealTime();
+
+// A quarter of the operations replace or remove an entry.
+static void BM_ConcurrentMap_Mixed(benchmark::State& state) {
+    ConcurrentMap<size_t, size_t>& map = sharedMap();
+    size_t key = state.thread_index();
+    size_t i = 0;
+
+    for (auto _ : state) {
+        key = (key + 1) % kKeys;
+        switch (i++ % 8) {
+            case 0:
+                map.set(size_t(key), key * 10);
+                break;
+            case 1:
+                map.eraseIfEqual(key, key * 10);
+                break;
+            default: {
+                std::unique_lock<std::mutex> lock = map.lock();
+                if (map.getLocked(key, key * 10) != key * 10) {
+                    state.SkipWithError("torn read");
+                }
+            }
+        }
+    }
+}
+BENCHMARK(BM_ConcurrentMap_Mixed)->ThreadRange(1, 16)->UseRealTime();
+
+static constexpr const char* kDescriptor = "android.hidl.benchmark@1.0::IConcurrency";
+
+struct ConcurrencyBase : public IBase {
+    Return<void> interfaceDescriptor(interfaceDescriptor_cb _hidl_cb) override {
+        _hidl_cb(kDescriptor);
+        return Void();
+    }
+};
+
+// Like a generated BnHw class: drops its gBnMap entry when destroyed.
+struct ConcurrencyBinder : public BHwBinder {
+    explicit ConcurrencyBinder(IBase* impl) : mImpl(impl) {}
+    ~ConcurrencyBinder() { gBnMap->eraseIfEqual(mImpl.get(), this); }
+
+    const sp<IBase> mImpl;
+};
+
+static IBase* sharedBase() {
+    static IBase* base = [] {
+        getBnConstructorMap().set(kDescriptor, [](void* iface) -> sp<IBinder> {
+            return new ConcurrencyBinder(static_cast<IBase*>(iface));
+        });
+        IBase* base = new ConcurrencyBase();
+        base->incStrong(nullptr);  // never destroyed
+        return base;
+    }();
+    return base;
+}
+
+static void cachedBinder(benchmark::State& state, bool keepAlive) {
+    IBase* base = sharedBase();
+    // Every thread holds the binder, so lookups only promote it.
+    sp<IBinder> anchor;
+    if (keepAlive) anchor = getOrCreateCachedBinder(base);
+
+    for (auto _ : state) {
+        sp<IBinder> binder = getOrCreateCachedBinder(base);
+        if (binder == nullptr || (keepAlive && binder != anchor)) {
+            state.SkipWithError("wrong cached binder");
+            break;
+        }
+    }
+}
+
+static void BM_CachedBinder_Alive(benchmark::State& state) {
+    cachedBinder(state, true /* keepAlive */);
+}
+BENCHMARK(BM_CachedBinder_Alive)->ThreadRange(1, 16)->UseRealTime();
+
+// Threads race to construct and destroy the binder.
+static void BM_CachedBinder_Churn(benchmark::State& state) {
+    cachedBinder(state, false /* keepAlive */);
+}
+BENCHMARK(BM_CachedBinder_Churn)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_TaskRunner_SharedPush(benchmark::State& state) {
+    static TaskRunner* runner;
+    static std::atomic<size_t> accepted;
+    static std::atomic<size_t> done;
+    if (state.thread_index() == 0) {
+        runner = new TaskRunner();
+        runner->start(1024 /* limit */);
+        accepted = 0;
+        done = 0;
+    }
+
+    for (auto _ : state) {
+        if (runner->push([] { done++; })) accepted++;
+    }
+
+    if (state.thread_index() == 0) {
+        delete runner;  // queued tasks keep running in the background
+        while (done < accepted) std::this_thread::yield();
+        state.counters["accepted"] = benchmark::Counter(static_cast<double>(accepted.load()),
+                                                        benchmark::Counter::kIsRate);
+    }
+}
+// All threads push into one runner; thread 0 sets it up before and tears it down after the loop.
+BENCHMARK(BM_TaskRunner_SharedPush)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_TaskRunner_StartPushDestroy(benchmark::State& state) {
+    for (auto _ : state) {
+        TaskRunner runner;
+        runner.start(1 /* limit */);
+        benchmark::DoNotOptimize(runner.push([] {}));
+    }
+}
+BENCHMARK(BM_TaskRunner_StartPushDestroy)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <hidl/AllocationCounter.h>
+#include <hidl/HidlSupport.h>
+
+using android::hardware::hidl_flat_copy;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::ScopedAllocationCounter;
+
+static hidl_vec<hidl_vec<uint8_t>> makeVecs(size_t count) {
+    hidl_vec<hidl_vec<uint8_t>> vecs(count);
+    for (size_t i = 0; i < count; ++i) {
+        vecs[i].resize(32 + i % 64);
+    }
+    return vecs;
+}
+
+static hidl_vec<hidl_string> makeStrings(size_t count) {
+    hidl_vec<hidl_string> strings(count);
+    for (size_t i = 0; i < count; ++i) {
+        strings[i] = "android.hardware.tests.bench@1.0::IBench/instance" + std::to_string(i);
+    }
+    return strings;
+}
+
+template <typename T>
+static size_t innerBytes(const hidl_vec<T>& vec) {
+    size_t bytes = 0;
+    for (const T& element : vec) {
+        bytes += element.size();
+    }
+    return bytes;
+}
+
+// allocs_per_copy counts every heap allocation made while copying, including hidl_string's mallocs.
+static void BM_FlatCopy_VecOfVec_HidlVec(benchmark::State& state) {
+    hidl_vec<hidl_vec<uint8_t>> vecs = makeVecs(state.range(0));
+    size_t allocations = 0;
+    for (auto _ : state) {
+        ScopedAllocationCounter counter;
+        hidl_vec<hidl_vec<uint8_t>> copy = vecs;
+        benchmark::DoNotOptimize(copy.data());
+        allocations += counter.count();
+    }
+    state.counters["allocs_per_copy"] = static_cast<double>(allocations) / state.iterations();
+    state.SetBytesProcessed(state.iterations() * innerBytes(vecs));
+}
+BENCHMARK(BM_FlatCopy_VecOfVec_HidlVec)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BM_FlatCopy_VecOfVec_Flat(benchmark::State& state) {
+    hidl_vec<hidl_vec<uint8_t>> vecs = makeVecs(state.range(0));
+    size_t allocations = 0;
+    for (auto _ : state) {
+        ScopedAllocationCounter counter;
+        hidl_flat_copy<hidl_vec<uint8_t>> copy(vecs);
+        benchmark::DoNotOptimize(copy.get().data());
+        allocations += counter.count();
+    }
+    state.counters["allocs_per_copy"] = static_cast<double>(allocations) / state.iterations();
+    state.SetBytesProcessed(state.iterations() * innerBytes(vecs));
+}
+BENCHMARK(BM_FlatCopy_VecOfVec_Flat)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BM_FlatCopy_VecOfString_HidlVec(benchmark::State& state) {
+    hidl_vec<hidl_string> strings = makeStrings(state.range(0));
+    size_t allocations = 0;
+    for (auto _ : state) {
+        ScopedAllocationCounter counter;
+        hidl_vec<hidl_string> copy = strings;
+        benchmark::DoNotOptimize(copy.data());
+        allocations += counter.count();
+    }
+    state.counters["allocs_per_copy"] = static_cast<double>(allocations) / state.iterations();
+    state.SetBytesProcessed(state.iterations() * innerBytes(strings));
+}
+BENCHMARK(BM_FlatCopy_VecOfString_HidlVec)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BM_FlatCopy_VecOfString_Flat(benchmark::State& state) {
+    hidl_vec<hidl_string> strings = makeStrings(state.range(0));
+    size_t allocations = 0;
+    for (auto _ : state) {
+        ScopedAllocationCounter counter;
+        hidl_flat_copy<hidl_string> copy(strings);
+        benchmark::DoNotOptimize(copy.get().data());
+        allocations += counter.count();
+    }
+    state.counters["allocs_per_copy"] = static_cast<double>(allocations) / state.iterations();
+    state.SetBytesProcessed(state.iterations() * innerBytes(strings));
+}
+BENCHMARK(BM_FlatCopy_VecOfString_Flat)->Arg(8)->Arg(64)->Arg(1024);
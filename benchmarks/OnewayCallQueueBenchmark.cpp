@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost per event to the caller of queueing oneway calls with OnewayCallQueue, and how many calls
+// are made per event when updates to a few keys are coalesced.
+
+#include <benchmark/benchmark.h>
+#include <hidl/OnewayCallQueue.h>
+
+using android::sp;
+using android::hardware::OnewayCallQueue;
+using android::hardware::Void;
+using android::hidl::base::V1_0::IBase;
+
+struct Target : public IBase {};
+
+static void BM_OnewayCallQueue(benchmark::State& state) {
+    uint64_t keys = static_cast<uint64_t>(state.range(0));  // 0: no coalescing
+    sp<IBase> target = new Target();
+    OnewayCallQueue queue;
+    uint64_t i = 0;
+
+    for (auto _ : state) {
+        uint64_t key = keys == 0 ? OnewayCallQueue::kNoCoalescing : 1 + i++ % keys;
+        queue.enqueue(target, [] { return Void(); }, 16, key);
+    }
+    queue.flush();
+
+    OnewayCallQueue::Stats stats = queue.getStats();
+    state.counters["calls_per_event"] =
+            static_cast<double>(stats.sent) / static_cast<double>(stats.queued);
+    state.counters["calls_per_batch"] =
+            static_cast<double>(stats.sent) / static_cast<double>(stats.batches);
+}
+BENCHMARK(BM_OnewayCallQueue)->Arg(0)->Arg(1)->Arg(8);
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <hidl/HidlBinderSupport.h>
+
+using android::hardware::computeParcelSize;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::Parcel;
+using android::hardware::reserveParcelSize;
+using android::hardware::writeEmbeddedToParcel;
+
+using Nested = hidl_vec<hidl_vec<hidl_string>>;
+
+static constexpr size_t kStringsPerVec = 16;
+
+static Nested makeNested(size_t count) {
+    Nested nested;
+    nested.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        nested[i].resize(kStringsPerVec);
+        for (size_t j = 0; j < kStringsPerVec; ++j) {
+            nested[i][j] = "android.hardware.tests.bench@1.0::IBench/" + std::to_string(i * j);
+        }
+    }
+    return nested;
+}
+
+// Writes nested the way generated code writes a vec<vec<string>> argument. Returns the number
+// of times the parcel's data buffer was reallocated if reallocs is set.
+static void writeNested(const Nested& nested, Parcel* parcel, size_t* reallocs = nullptr) {
+    size_t capacity = parcel->dataCapacity();
+    auto check = [&] {
+        if (reallocs != nullptr && parcel->dataCapacity() != capacity) {
+            capacity = parcel->dataCapacity();
+            ++*reallocs;
+        }
+    };
+
+    size_t parentHandle;
+    size_t vecHandle;
+    parcel->writeBuffer(&nested, sizeof(nested), &parentHandle);
+    writeEmbeddedToParcel(nested, parcel, parentHandle, 0, &vecHandle);
+    check();
+    for (size_t i = 0; i < nested.size(); ++i) {
+        size_t childHandle;
+        writeEmbeddedToParcel(nested[i], parcel, vecHandle, i * sizeof(hidl_vec<hidl_string>),
+                              &childHandle);
+        check();
+        for (size_t j = 0; j < nested[i].size(); ++j) {
+            writeEmbeddedToParcel(nested[i][j], parcel, childHandle, j * sizeof(hidl_string));
+            check();
+        }
+    }
+}
+
+static void BM_WriteNested_Grow(benchmark::State& state) {
+    Nested nested = makeNested(state.range(0));
+
+    size_t reallocs = 0;
+    {
+        Parcel parcel;
+        writeNested(nested, &parcel, &reallocs);
+    }
+
+    for (auto _ : state) {
+        Parcel parcel;
+        writeNested(nested, &parcel);
+        benchmark::DoNotOptimize(parcel.data());
+    }
+    state.counters["reallocs"] = reallocs;
+}
+BENCHMARK(BM_WriteNested_Grow)->RangeMultiplier(8)->Range(8, 4096);
+
+static void BM_WriteNested_Presized(benchmark::State& state) {
+    Nested nested = makeNested(state.range(0));
+
+    size_t reallocs = 0;
+    {
+        Parcel parcel;
+        reserveParcelSize(&parcel, computeParcelSize(nested));
+        writeNested(nested, &parcel, &reallocs);
+    }
+
+    for (auto _ : state) {
+        Parcel parcel;
+        reserveParcelSize(&parcel, computeParcelSize(nested));
+        writeNested(nested, &parcel);
+        benchmark::DoNotOptimize(parcel.data());
+    }
+    state.counters["reallocs"] = reallocs;
+}
+BENCHMARK(BM_WriteNested_Presized)->RangeMultiplier(8)->Range(8, 4096);
+
+static void BM_ComputeParcelSize(benchmark::State& state) {
+    Nested nested = makeNested(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(computeParcelSize(nested));
+    }
+}
+BENCHMARK(BM_ComputeParcelSize)->RangeMultiplier(8)->Range(8, 4096);
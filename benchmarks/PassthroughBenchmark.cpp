@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures passthrough lookups against temporary directories standing in for the ODM, vendor and
+// system HAL directories. Each holds the given number of other HALs' (empty) libraries, and the
+// system one also holds a copy of libhidl_benchmark_passthrough_impl.so, named like a real
+// android.hidl.benchmark@1.0 implementation.
+//
+// Cold lookups load a new copy of the implementation every iteration; warm lookups find the one
+// which is already loaded. The implementation is loaded in the sphal namespace like vendor HALs,
+// and lookups are skipped with an error on devices where that namespace may not load from
+// temporary directories. There is no such restriction on host.
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android/hidl/manager/1.0/IServiceManager.h>
+#include <benchmark/benchmark.h>
+#include <hidl/ServiceManagement.h>
+
+using android::sp;
+using android::base::TemporaryDir;
+using android::hardware::getPassthroughServiceManager;
+using android::hardware::details::preloadPassthroughService;
+using android::hardware::details::setPassthroughLibraryPaths;
+using android::hidl::base::V1_0::IBase;
+using android::hidl::manager::V1_0::IServiceManager;
+
+static constexpr const char* kFqName = "android.hidl.benchmark@1.0::IFoo";
+static constexpr const char* kImplPrefix = "android.hidl.benchmark@1.0-impl";
+
+class HalDirectories {
+   public:
+    explicit HalDirectories(size_t files) {
+        CHECK(android::base::ReadFileToString(
+                android::base::GetExecutableDirectory() + "/libhidl_benchmark_passthrough_impl.so",
+                &mImpl));
+
+        for (TemporaryDir* dir : {&mOdm, &mVendor, &mSystem}) {
+            for (size_t i = 0; i < files; ++i) {
+                std::string name = std::string(dir->path) + "/android.hardware.filler" +
+                                   std::to_string(i) + "@1.0-impl.so";
+                CHECK(android::base::WriteStringToFile("", name));
+            }
+        }
+        newImpl();
+    }
+
+    ~HalDirectories() {
+        unlink(mImplPath.c_str());
+        for (TemporaryDir* dir : {&mOdm, &mVendor, &mSystem}) {
+            std::unique_ptr<DIR, decltype(&closedir)> d(opendir(dir->path), closedir);
+            while (dirent* dp = readdir(d.get())) {
+                unlink((std::string(dir->path) + "/" + dp->d_name).c_str());
+            }
+        }
+    }
+
+    // Replaces the implementation with a copy which has not been loaded yet.
+    void newImpl() {
+        if (!mImplPath.empty()) unlink(mImplPath.c_str());
+        mImplPath = std::string(mSystem.path) + "/" + kImplPrefix + "-" +
+                    std::to_string(mGeneration++) + ".so";
+        CHECK(android::base::WriteStringToFile(mImpl, mImplPath));
+    }
+
+    void use() {
+        setPassthroughLibraryPaths({std::string(mOdm.path) + "/", std::string(mVendor.path) + "/",
+                                    std::string(mSystem.path) + "/"});
+    }
+
+   private:
+    std::string mImpl;
+    TemporaryDir mOdm;
+    TemporaryDir mVendor;
+    TemporaryDir mSystem;
+    std::string mImplPath;
+    size_t mGeneration = 0;
+};
+
+// Creating 10k files takes a while, so the directories are shared between benchmarks.
+static HalDirectories& directories(size_t files) {
+    static std::map<size_t, std::unique_ptr<HalDirectories>> sDirectories;
+    std::unique_ptr<HalDirectories>& dirs = sDirectories[files];
+    if (dirs == nullptr) dirs = std::make_unique<HalDirectories>(files);
+    dirs->use();
+    return *dirs;
+}
+
+static void get(benchmark::State& state, bool cold) {
+    HalDirectories& dirs = directories(state.range(0));
+    sp<IServiceManager> pm = getPassthroughServiceManager();
+
+    for (auto _ : state) {
+        if (cold) {
+            state.PauseTiming();
+            dirs.newImpl();
+            state.ResumeTiming();
+        }
+        sp<IBase> service = pm->get(kFqName, "default").withDefault(nullptr);
+        if (service == nullptr) {
+            state.SkipWithError("passthrough get failed");
+            break;
+        }
+    }
+    setPassthroughLibraryPaths({});
+}
+
+static void BM_PassthroughGet_Cold(benchmark::State& state) {
+    get(state, true /* cold */);
+}
+// Every iteration leaves a library loaded.
+BENCHMARK(BM_PassthroughGet_Cold)->RangeMultiplier(10)->Range(10, 10000)->Iterations(100);
+
+static void BM_PassthroughGet_Warm(benchmark::State& state) {
+    get(state, false /* cold */);
+}
+BENCHMARK(BM_PassthroughGet_Warm)->RangeMultiplier(10)->Range(10, 10000);
+
+static void preload(benchmark::State& state, bool cold) {
+    HalDirectories& dirs = directories(state.range(0));
+
+    for (auto _ : state) {
+        if (cold) {
+            state.PauseTiming();
+            dirs.newImpl();
+            state.ResumeTiming();
+        }
+        preloadPassthroughService(kFqName);
+    }
+    setPassthroughLibraryPaths({});
+}
+
+static void BM_PreloadPassthroughService_Cold(benchmark::State& state) {
+    preload(state, true /* cold */);
+}
+BENCHMARK(BM_PreloadPassthroughService_Cold)
+        ->RangeMultiplier(10)
+        ->Range(10, 10000)
+        ->Iterations(100);
+
+static void BM_PreloadPassthroughService_Warm(benchmark::State& state) {
+    preload(state, false /* cold */);
+}
+BENCHMARK(BM_PreloadPassthroughService_Warm)->RangeMultiplier(10)->Range(10, 10000);
+
+// Lists every library in the directories and scans the maps of every process for clients.
+static void BM_PassthroughDebugDump(benchmark::State& state) {
+    directories(state.range(0));
+    sp<IServiceManager> pm = getPassthroughServiceManager();
+
+    for (auto _ : state) {
+        size_t instances = 0;
+        pm->debugDump([&](const auto& infos) { instances = infos.size(); });
+        benchmark::DoNotOptimize(instances);
+    }
+    setPassthroughLibraryPaths({});
+}
+BENCHMARK(BM_PassthroughDebugDump)->RangeMultiplier(10)->Range(10, 10000);
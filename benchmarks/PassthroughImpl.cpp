@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stands in for android.hidl.benchmark@1.0-impl.so in PassthroughBenchmark.
+
+#include <string.h>
+
+#include <android/hidl/base/1.0/IBase.h>
+
+using android::hidl::base::V1_0::IBase;
+
+struct Foo : public IBase {};
+
+extern "C" IBase* HIDL_FETCH_IFoo(const char* name) {
+    if (strcmp(name, "default") != 0) return nullptr;
+    return new Foo();
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Wraps 100k passthrough objects whose interface extends, through the given number of levels, the
+// only one with a Bs constructor, like a partner extension of an AOSP interface.
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hidl/HidlPassthroughSupport.h>
+#include <hidl/Static.h>
+
+using android::sp;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::Return;
+using android::hardware::Void;
+using android::hardware::details::getBsConstructorMap;
+using android::hardware::details::wrapPassthroughInternal;
+using android::hidl::base::V1_0::IBase;
+
+static constexpr const char* kWrappedDescriptor = "android.hidl.benchmark@1.0::IWrapped";
+static constexpr size_t kObjects = 100000;
+
+struct Extension : public IBase {
+    explicit Extension(const hidl_vec<hidl_string>& chain) : mChain(chain) {}
+
+    Return<void> interfaceChain(interfaceChain_cb _hidl_cb) override {
+        _hidl_cb(mChain);
+        return Void();
+    }
+
+    const hidl_vec<hidl_string>& mChain;
+};
+
+struct Wrapper : public IBase {
+    explicit Wrapper(IBase* impl) : mImpl(impl) {}
+    const sp<IBase> mImpl;
+};
+
+static void BM_WrapPassthrough(benchmark::State& state) {
+    static bool registered = [] {
+        getBsConstructorMap().set(kWrappedDescriptor, [](void* iface) -> sp<IBase> {
+            return new Wrapper(static_cast<IBase*>(iface));
+        });
+        return true;
+    }();
+    (void)registered;
+
+    // e.x. vendor.foo@1.1::IFoo, vendor.foo@1.0::IFoo, IWrapped, IBase
+    std::vector<hidl_string> chain;
+    for (int64_t i = state.range(0); i > 0; --i) {
+        chain.push_back("vendor.benchmark@1." + std::to_string(i) + "::IExtension");
+    }
+    chain.push_back(kWrappedDescriptor);
+    chain.push_back(IBase::descriptor);
+    hidl_vec<hidl_string> chainVec(chain.begin(), chain.end());
+
+    std::vector<sp<IBase>> objects;
+    for (size_t i = 0; i < kObjects; ++i) objects.push_back(new Extension(chainVec));
+
+    for (auto _ : state) {
+        for (const sp<IBase>& object : objects) {
+            sp<IBase> wrapped = wrapPassthroughInternal(object);
+            if (wrapped == nullptr) {
+                state.SkipWithError("could not wrap");
+                return;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kObjects);
+}
+BENCHMARK(BM_WrapPassthrough)->DenseRange(0, 3)->Unit(benchmark::kMillisecond);
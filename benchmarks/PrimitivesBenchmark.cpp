@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <hidl/HidlSupport.h>
+#include <hidl/Status.h>
+#include <hidl/TaskRunner.h>
+
+using android::hardware::hidl_array;
+using android::hardware::hidl_handle;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::Return;
+using android::hardware::Status;
+using android::hardware::toString;
+using android::hardware::details::TaskRunner;
+
+// ---------------------- hidl_string
+
+static void BM_HidlString_Construct(benchmark::State& state) {
+    std::string s(state.range(0), 'x');
+    for (auto _ : state) {
+        hidl_string string(s);
+        benchmark::DoNotOptimize(string.c_str());
+    }
+}
+BENCHMARK(BM_HidlString_Construct)->Arg(8)->Arg(64)->Arg(4096);
+
+static void BM_HidlString_Copy(benchmark::State& state) {
+    hidl_string string(std::string(state.range(0), 'x'));
+    for (auto _ : state) {
+        hidl_string copy(string);
+        benchmark::DoNotOptimize(copy.c_str());
+    }
+}
+BENCHMARK(BM_HidlString_Copy)->Arg(8)->Arg(64)->Arg(4096);
+
+static void BM_HidlString_Move(benchmark::State& state) {
+    hidl_string a(std::string(state.range(0), 'x'));
+    hidl_string b;
+    for (auto _ : state) {
+        b = std::move(a);
+        a = std::move(b);
+        benchmark::DoNotOptimize(a.c_str());
+    }
+}
+BENCHMARK(BM_HidlString_Move)->Arg(64);
+
+static void BM_HidlString_Compare(benchmark::State& state) {
+    std::string s(state.range(0), 'x');
+    hidl_string a(s);
+    hidl_string b(s);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a == b);
+    }
+}
+BENCHMARK(BM_HidlString_Compare)->Arg(8)->Arg(64)->Arg(4096);
+
+// ---------------------- hidl_vec
+
+static void BM_HidlVec_Construct(benchmark::State& state) {
+    for (auto _ : state) {
+        hidl_vec<uint32_t> vec(state.range(0));
+        benchmark::DoNotOptimize(vec.data());
+    }
+}
+BENCHMARK(BM_HidlVec_Construct)->Arg(8)->Arg(1024);
+
+static void BM_HidlVec_Copy(benchmark::State& state) {
+    hidl_vec<uint32_t> vec(state.range(0));
+    for (auto _ : state) {
+        hidl_vec<uint32_t> copy(vec);
+        benchmark::DoNotOptimize(copy.data());
+    }
+}
+BENCHMARK(BM_HidlVec_Copy)->Arg(8)->Arg(1024);
+
+static void BM_HidlVec_Move(benchmark::State& state) {
+    hidl_vec<uint32_t> a(state.range(0));
+    hidl_vec<uint32_t> b;
+    for (auto _ : state) {
+        b = std::move(a);
+        a = std::move(b);
+        benchmark::DoNotOptimize(a.data());
+    }
+}
+BENCHMARK(BM_HidlVec_Move)->Arg(1024);
+
+static void BM_HidlVec_Resize(benchmark::State& state) {
+    hidl_vec<uint32_t> vec(state.range(0));
+    for (auto _ : state) {
+        vec.resize(state.range(0) + 1);
+        vec.resize(state.range(0));
+        benchmark::DoNotOptimize(vec.data());
+    }
+}
+BENCHMARK(BM_HidlVec_Resize)->Arg(8)->Arg(1024);
+
+static void BM_HidlVec_Compare(benchmark::State& state) {
+    hidl_vec<uint32_t> a(state.range(0));
+    hidl_vec<uint32_t> b(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a == b);
+    }
+}
+BENCHMARK(BM_HidlVec_Compare)->Arg(8)->Arg(1024);
+
+static void BM_HidlVec_ToString(benchmark::State& state) {
+    hidl_vec<uint32_t> vec(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(toString(vec));
+    }
+}
+BENCHMARK(BM_HidlVec_ToString)->Arg(8)->Arg(1024);
+
+// ---------------------- hidl_array
+
+static void BM_HidlArray_Copy(benchmark::State& state) {
+    hidl_array<uint32_t, 16, 16> array;
+    for (auto _ : state) {
+        hidl_array<uint32_t, 16, 16> copy(array);
+        benchmark::DoNotOptimize(copy.data());
+    }
+}
+BENCHMARK(BM_HidlArray_Copy);
+
+static void BM_HidlArray_Compare(benchmark::State& state) {
+    hidl_array<uint32_t, 16, 16> a;
+    hidl_array<uint32_t, 16, 16> b;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a == b);
+    }
+}
+BENCHMARK(BM_HidlArray_Compare);
+
+static void BM_HidlArray_ToString(benchmark::State& state) {
+    hidl_array<uint32_t, 16, 16> array;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(toString(array));
+    }
+}
+BENCHMARK(BM_HidlArray_ToString);
+
+// ---------------------- hidl_handle
+
+static void BM_HidlHandle_Clone(benchmark::State& state) {
+    native_handle_t* handle = native_handle_create(state.range(0) /* numFds */, 0 /* numInts */);
+    for (int i = 0; i < state.range(0); ++i) {
+        handle->data[i] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    hidl_handle hidlHandle;
+    hidlHandle.setTo(handle, true /* shouldOwn */);
+
+    for (auto _ : state) {
+        hidl_handle copy(hidlHandle);
+        benchmark::DoNotOptimize(copy.getNativeHandle());
+    }
+}
+BENCHMARK(BM_HidlHandle_Clone)->Arg(0)->Arg(1)->Arg(4);
+
+// ---------------------- Status/Return
+
+static Return<int32_t> okReturn(int32_t value) {
+    return value;
+}
+
+static void BM_Return_CheckOk(benchmark::State& state) {
+    int32_t i = 0;
+    for (auto _ : state) {
+        Return<int32_t> ret = okReturn(i++);
+        if (!ret.isOk()) state.SkipWithError("unexpected error");
+        benchmark::DoNotOptimize(static_cast<int32_t>(ret));
+    }
+}
+BENCHMARK(BM_Return_CheckOk);
+
+static void BM_Return_Void(benchmark::State& state) {
+    for (auto _ : state) {
+        Return<void> ret;
+        benchmark::DoNotOptimize(ret.isOk());
+    }
+}
+BENCHMARK(BM_Return_Void);
+
+static void BM_Status_Description(benchmark::State& state) {
+    Status status = Status::fromExceptionCode(Status::EX_TRANSACTION_FAILED, "benchmark");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(status.description());
+    }
+}
+BENCHMARK(BM_Status_Description);
+
+// ---------------------- TaskRunner
+
+// Pushes a batch of tasks and waits for the background thread to pop and run all of them.
+static void BM_TaskRunner_PushPop(benchmark::State& state) {
+    TaskRunner runner;
+    runner.start(state.range(0));
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    size_t done = 0;
+    auto task = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++done == static_cast<size_t>(state.range(0))) condition.notify_one();
+    };
+
+    for (auto _ : state) {
+        done = 0;
+        for (int i = 0; i < state.range(0); ++i) {
+            if (!runner.push(task)) state.SkipWithError("push failed");
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&] { return done == static_cast<size_t>(state.range(0)); });
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TaskRunner_PushPop)->Arg(1)->Arg(64);
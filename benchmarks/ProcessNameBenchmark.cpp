@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace hardware {
+namespace details {
+// Called by generated code on each registration, and declared by it rather than in a header.
+void onRegistration(const std::string& packageName, const std::string& interfaceName,
+                    const std::string& instanceName);
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
+
+using android::hardware::details::onRegistration;
+
+// The child is run as a service binary of kPackage, so its first registration renames the threads
+// still named after it (the first 15 characters of kProcessName) to drop the namespace.
+static const char* kProcessName = "bench.rename@1.0-service";
+static const char* kPackage = "bench.rename@1.0";
+static const char* kInterface = "IFoo";
+static const std::string kDescriptor = std::string(kPackage) + "::" + kInterface;
+static const std::string kThreadName = std::string(kProcessName).substr(0, 15);
+static const std::string kNewName = "rename@1.0-service";
+
+// Threads which idle until destroyed, as in a process with a large thread pool.
+class IdleThreads {
+   public:
+    explicit IdleThreads(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            mThreads.emplace_back([this] {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCondition.wait(lock, [this] { return mDone; });
+            });
+            pthread_setname_np(mThreads.back().native_handle(), kThreadName.c_str());
+        }
+    }
+
+    ~IdleThreads() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDone = true;
+        }
+        mCondition.notify_all();
+        for (std::thread& thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    std::string name(size_t i) {
+        char name[16] = {};
+        pthread_getname_np(mThreads[i].native_handle(), name, sizeof(name));
+        return name;
+    }
+
+   private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mDone = false;
+    std::vector<std::thread> mThreads;
+};
+
+// The walk as it was done before, with an fstream per thread.
+static size_t renameThreadsWithFstream(const std::string& descriptor, const std::string& newName) {
+    const static std::string kTasks = "/proc/self/task/";
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kTasks.c_str()), closedir);
+    if (dir == nullptr) return 0;
+
+    size_t renamed = 0;
+    dirent* dp;
+    while ((dp = readdir(dir.get())) != nullptr) {
+        if (dp->d_type != DT_DIR) continue;
+        if (dp->d_name[0] == '.') continue;
+
+        std::fstream fs(kTasks + dp->d_name + "/comm");
+        if (!fs) continue;
+
+        std::string oldComm;
+        if (!(fs >> oldComm)) continue;
+
+        if (descriptor.compare(0, oldComm.size(), oldComm) == 0) {
+            if (!fs.seekg(0, fs.beg)) continue;
+            fs << newName;
+            renamed++;
+        }
+    }
+    return renamed;
+}
+
+// Run by main() in the child started by timeFirstRegistration: starts threadCount threads named
+// after this binary, renames them with walk ("hidl" for the first registration of a service in
+// libhidlbase, or "fstream" for the old walk alone), and prints how long that took in nanoseconds.
+// Fails unless the threads were renamed.
+int processNameChildMain(const char* walk, size_t threadCount) {
+    // Every registration is logged at INFO, which would be most of what is measured.
+    android::base::SetMinimumLogSeverity(android::base::WARNING);
+    IdleThreads threads(threadCount);
+
+    auto start = std::chrono::steady_clock::now();
+    if (strcmp(walk, "fstream") == 0) {
+        renameThreadsWithFstream(kDescriptor, kNewName);
+    } else {
+        onRegistration(kPackage, kInterface, "default");
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (threadCount == 0 || threads.name(threadCount - 1) != kNewName.substr(0, 15)) {
+        fprintf(stderr, "threads were not renamed by the %s walk\n", walk);
+        return 1;
+    }
+    printf("%lld\n", static_cast<long long>(
+                             std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    return 0;
+}
+
+// Runs processNameChildMain in a new process of this binary named kProcessName, since the rename
+// is only attempted for the first registration in a process. Returns the time it reports in
+// seconds, or a negative number on error.
+static double timeFirstRegistration(const char* walk, int64_t threadCount) {
+    std::string threads = std::to_string(threadCount);
+    char* argv[] = {const_cast<char*>(kProcessName), const_cast<char*>("--process_name_child"),
+                    const_cast<char*>(walk), &threads[0], nullptr};
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        execv("/proc/self/exe", argv);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    std::string output;
+    char buf[64];
+    ssize_t n;
+    while ((n = TEMP_FAILURE_RETRY(read(fds[0], buf, sizeof(buf)))) > 0) {
+        output.append(buf, n);
+    }
+    close(fds[0]);
+
+    int status;
+    if (pid == -1 || TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)) != pid) return -1;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || output.empty()) return -1;
+    return strtoll(output.c_str(), nullptr, 10) / 1e9;
+}
+
+// The first registration of a service in its own binary's package, which renames the threads of
+// a process with a large thread pool. Each iteration is a new process, and only the registration
+// (or the old walk alone) is timed.
+static void BM_FirstRegistration(benchmark::State& state, const char* walk) {
+    for (auto _ : state) {
+        double seconds = timeFirstRegistration(walk, state.range(0));
+        if (seconds < 0) {
+            state.SkipWithError("child process failed");
+            break;
+        }
+        state.SetIterationTime(seconds);
+    }
+}
+BENCHMARK_CAPTURE(BM_FirstRegistration, fstream, "fstream")->Arg(500)->UseManualTime();
+BENCHMARK_CAPTURE(BM_FirstRegistration, hidl, "hidl")->Arg(500)->UseManualTime();
+
+// Registering services from a package other than the binary's, e.x. a HAL in a shared process:
+// nothing is renamed once the packages are compared, however many threads the process has.
+static void BM_OnRegistration_Repeated(benchmark::State& state) {
+    IdleThreads threads(state.range(0));
+    // Every registration is logged at INFO, which would be most of what is measured.
+    android::base::LogSeverity severity =
+            android::base::SetMinimumLogSeverity(android::base::WARNING);
+    for (auto _ : state) {
+        onRegistration("android.hardware.tests.bench@1.0", "IBench", "default");
+    }
+    android::base::SetMinimumLogSeverity(severity);
+}
+BENCHMARK(BM_OnRegistration_Repeated)->Arg(500);
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Calls to a service's interfaceChain through a ResponseCache, against calling it directly. The
+// service is the hwservicemanager, so direct calls cross binder.
+
+#include <benchmark/benchmark.h>
+#include <hidl/ResponseCache.h>
+#include <hidl/ServiceManagement.h>
+
+using android::sp;
+using android::hardware::defaultServiceManager;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::ResponseCache;
+using android::hidl::base::V1_0::IBase;
+
+static void BM_InterfaceChain_Direct(benchmark::State& state) {
+    sp<IBase> service = defaultServiceManager();
+    if (service == nullptr) {
+        state.SkipWithError("no service manager");
+        return;
+    }
+
+    for (auto _ : state) {
+        size_t size = 0;
+        if (!service->interfaceChain([&](const hidl_vec<hidl_string>& c) { size = c.size(); })
+                     .isOk()) {
+            state.SkipWithError("interfaceChain failed");
+            break;
+        }
+        benchmark::DoNotOptimize(size);
+    }
+}
+BENCHMARK(BM_InterfaceChain_Direct);
+
+static void BM_InterfaceChain_Cached(benchmark::State& state) {
+    sp<IBase> service = defaultServiceManager();
+    if (service == nullptr) {
+        state.SkipWithError("no service manager");
+        return;
+    }
+    sp<ResponseCache> cache = ResponseCache::create(service);
+
+    for (auto _ : state) {
+        size_t size = 0;
+        if (!cache->interfaceChain([&](const hidl_vec<hidl_string>& c) { size = c.size(); })
+                     .isOk()) {
+            state.SkipWithError("interfaceChain failed");
+            break;
+        }
+        benchmark::DoNotOptimize(size);
+    }
+
+    for (const ResponseCache::MethodStats& stats : cache->getStats()) {
+        if (stats.method == "interfaceChain") state.counters["hit_rate"] = stats.hitRate();
+    }
+    cache->close();
+}
+BENCHMARK(BM_InterfaceChain_Cached);
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures getService (details::getRawServiceInternal) against an in-process stand-in for
+// hwservicemanager, counting the calls each lookup makes to the service manager and to the
+// service. On hardware, each of these calls is a hwbinder transaction.
+//
+// On devices without PRODUCT_ENFORCE_VINTF_MANIFEST, every lookup also sleeps for a second
+// before asking for the service, which dominates these numbers.
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android/hidl/manager/1.2/IServiceManager.h>
+#include <benchmark/benchmark.h>
+#include <hidl/ServiceManagement.h>
+
+using android::sp;
+using android::hardware::hidl_string;
+using android::hardware::hidl_vec;
+using android::hardware::Return;
+using android::hardware::Void;
+using android::hardware::details::getRawServiceInternal;
+using android::hidl::base::V1_0::IBase;
+using android::hidl::manager::V1_0::IServiceNotification;
+using android::hidl::manager::V1_2::IClientCallback;
+using android::hidl::manager::V1_2::IServiceManager;
+
+// Not in any manifest, so the transport always comes from the service manager.
+static constexpr const char* kDescriptor = "android.hidl.benchmark@1.0::IFake";
+static constexpr const char* kInstance = "default";
+static constexpr std::chrono::microseconds kStartLatency{200};
+
+struct FakeService : public IBase {
+    explicit FakeService(std::atomic<size_t>* calls) : mCalls(calls) {}
+
+    Return<void> interfaceChain(interfaceChain_cb _hidl_cb) override {
+        (*mCalls)++;
+        _hidl_cb({kDescriptor, IBase::descriptor});
+        return Void();
+    }
+
+   private:
+    std::atomic<size_t>* mCalls;
+};
+
+// Serves a single instance of kDescriptor.
+struct FakeServiceManager : public IServiceManager {
+    enum class Mode {
+        PRESENT,  // registered before the lookup
+        ABSENT,   // not declared in the manifest
+        LAZY,     // declared, started by the first get()
+        LATE,     // declared, registers on its own shortly after the lookup starts
+        MANUAL,   // declared, registered with setRegistered
+    };
+
+    explicit FakeServiceManager(Mode mode) : mMode(mode), mService(new FakeService(&calls)) {}
+
+    ~FakeServiceManager() { finishIteration(); }
+
+    // Puts the service back in its initial state.
+    void startIteration() {
+        finishIteration();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRegistered = mMode == Mode::PRESENT;
+        if (mMode == Mode::LATE) {
+            mStarter = std::thread([this] { startService(); });
+        }
+    }
+
+    void finishIteration() {
+        if (mStarter.joinable()) mStarter.join();
+    }
+
+    void setRegistered(bool registered) {
+        if (registered) {
+            startService();
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRegistered = false;
+    }
+
+    size_t registeredCallbacks() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCallbacks.size();
+    }
+
+    Return<sp<IBase>> get(const hidl_string&, const hidl_string&) override {
+        calls++;
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mRegistered) return sp<IBase>(mService);
+        if (mMode == Mode::LAZY && !mStarter.joinable()) {
+            mStarter = std::thread([this] { startService(); });
+        }
+        return sp<IBase>(nullptr);
+    }
+
+    Return<Transport> getTransport(const hidl_string&, const hidl_string&) override {
+        calls++;
+        return mMode == Mode::ABSENT ? Transport::EMPTY : Transport::HWBINDER;
+    }
+
+    Return<bool> registerForNotifications(const hidl_string& fqName, const hidl_string& name,
+                                          const sp<IServiceNotification>& callback) override {
+        calls++;
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCallbacks.push_back(callback);
+        bool registered = mRegistered;
+        lock.unlock();
+
+        // like hwservicemanager, report an instance which is already there
+        if (registered) callback->onRegistration(fqName, name, true /* preexisting */);
+        return true;
+    }
+
+    Return<bool> unregisterForNotifications(const hidl_string&, const hidl_string&,
+                                            const sp<IServiceNotification>& callback) override {
+        calls++;
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto it = mCallbacks.begin(); it != mCallbacks.end(); ++it) {
+            if (*it == callback) {
+                mCallbacks.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The rest is not used by getService.
+    Return<bool> add(const hidl_string&, const sp<IBase>&) override { return false; }
+    Return<void> list(list_cb _hidl_cb) override {
+        _hidl_cb({});
+        return Void();
+    }
+    Return<void> listByInterface(const hidl_string&, listByInterface_cb _hidl_cb) override {
+        _hidl_cb({});
+        return Void();
+    }
+    Return<void> debugDump(debugDump_cb _hidl_cb) override {
+        _hidl_cb({});
+        return Void();
+    }
+    Return<void> registerPassthroughClient(const hidl_string&, const hidl_string&) override {
+        return Void();
+    }
+    Return<bool> registerClientCallback(const hidl_string&, const hidl_string&, const sp<IBase>&,
+                                        const sp<IClientCallback>&) override {
+        return false;
+    }
+    Return<bool> unregisterClientCallback(const sp<IBase>&, const sp<IClientCallback>&) override {
+        return false;
+    }
+    Return<bool> addWithChain(const hidl_string&, const sp<IBase>&,
+                              const hidl_vec<hidl_string>&) override {
+        return false;
+    }
+    Return<void> listManifestByInterface(const hidl_string&,
+                                         listManifestByInterface_cb _hidl_cb) override {
+        _hidl_cb({});
+        return Void();
+    }
+    Return<bool> tryUnregister(const hidl_string&, const hidl_string&, const sp<IBase>&) override {
+        return false;
+    }
+
+    // calls to the service manager and to the service
+    std::atomic<size_t> calls{0};
+
+   private:
+    void startService() {
+        if (mMode != Mode::MANUAL) std::this_thread::sleep_for(kStartLatency);
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mRegistered = true;
+        std::vector<sp<IServiceNotification>> callbacks = mCallbacks;
+        lock.unlock();
+
+        for (const auto& callback : callbacks) {
+            callback->onRegistration(kDescriptor, kInstance, false /* preexisting */);
+        }
+    }
+
+    const Mode mMode;
+    const sp<FakeService> mService;
+
+    std::mutex mMutex;
+    bool mRegistered = false;
+    std::vector<sp<IServiceNotification>> mCallbacks;
+    std::thread mStarter;
+};
+
+static void lookup(benchmark::State& state, FakeServiceManager::Mode mode, bool expectService) {
+    sp<FakeServiceManager> sm = new FakeServiceManager(mode);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        sm->startIteration();
+        state.ResumeTiming();
+
+        sp<IBase> service =
+                getRawServiceInternal(sm, kDescriptor, kInstance, true /* retry */,
+                                      false /* getStub */);
+        if ((service != nullptr) != expectService) {
+            state.SkipWithError("unexpected getService result");
+            break;
+        }
+    }
+    sm->finishIteration();
+
+    state.counters["calls_per_lookup"] = benchmark::Counter(
+            static_cast<double>(sm->calls.load()), benchmark::Counter::kAvgIterations);
+}
+
+static void BM_GetService_Present(benchmark::State& state) {
+    lookup(state, FakeServiceManager::Mode::PRESENT, true);
+}
+BENCHMARK(BM_GetService_Present);
+
+static void BM_GetService_Absent(benchmark::State& state) {
+    lookup(state, FakeServiceManager::Mode::ABSENT, false);
+}
+BENCHMARK(BM_GetService_Absent);
+
+// includes kStartLatency
+static void BM_GetService_Lazy(benchmark::State& state) {
+    lookup(state, FakeServiceManager::Mode::LAZY, true);
+}
+BENCHMARK(BM_GetService_Lazy)->UseRealTime();
+
+// includes kStartLatency
+static void BM_GetService_Late(benchmark::State& state) {
+    lookup(state, FakeServiceManager::Mode::LATE, true);
+}
+BENCHMARK(BM_GetService_Late)->UseRealTime();
+
+// Many threads look up a service which keeps unregistering and registering again, racing the
+// Waiter's reset, get and wait against notifications. Every lookup must find the service, and no
+// Waiter may be left registered.
+static void BM_GetService_Flapping(benchmark::State& state) {
+    static sp<FakeServiceManager> sm;
+    static std::atomic<bool> stop;
+    static std::thread flapper;
+    if (state.thread_index() == 0) {
+        sm = new FakeServiceManager(FakeServiceManager::Mode::MANUAL);
+        stop = false;
+        flapper = std::thread([] {
+            for (bool registered = true; !stop; registered = !registered) {
+                sm->setRegistered(registered);
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            sm->setRegistered(true);
+        });
+    }
+
+    for (auto _ : state) {
+        sp<IBase> service = getRawServiceInternal(sm, kDescriptor, kInstance, true /* retry */,
+                                                  false /* getStub */);
+        if (service == nullptr) {
+            state.SkipWithError("lookup of a flapping service failed");
+            break;
+        }
+    }
+
+    if (state.thread_index() == 0) {
+        stop = true;
+        flapper.join();
+        if (sm->registeredCallbacks() != 0) {
+            state.SkipWithError("Waiter left registered for notifications");
+        }
+        sm = nullptr;
+    }
+}
+BENCHMARK(BM_GetService_Flapping)->ThreadRange(1, 16)->UseRealTime();
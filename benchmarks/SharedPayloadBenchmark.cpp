@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hidl/HidlSupport.h>
+#include <hidlmemory/SharedPayload.h>
+
+using android::hardware::hidl_vec;
+using android::hardware::SharedPayload;
+using android::hardware::SharedPayloadPool;
+using android::hardware::SharedPayloadView;
+
+// The receiver touches every page, as it would when consuming the payload.
+static uint8_t touchPages(const uint8_t* data, size_t size) {
+    static const size_t kPageSize = static_cast<size_t>(getpagesize());
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i += kPageSize) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+// Inline transfer: the sender copies into a hidl_vec and the driver copies that into the
+// receiver's transaction buffer (stood in for by a memcpy here).
+static void BM_Payload_Inline(benchmark::State& state) {
+    size_t size = state.range(0);
+    std::vector<uint8_t> source(size, 0xAB);
+    std::vector<uint8_t> receiverBuffer(size);
+
+    for (auto _ : state) {
+        hidl_vec<uint8_t> vec(source.begin(), source.end());
+        memcpy(receiverBuffer.data(), vec.data(), vec.size());
+        benchmark::DoNotOptimize(touchPages(receiverBuffer.data(), size));
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+    // Anything above the 1MB transaction buffer cannot actually be sent this way.
+    state.counters["fits_in_transaction"] = size < 1024 * 1024;
+}
+BENCHMARK(BM_Payload_Inline)->RangeMultiplier(4)->Range(1 << 10, 64 << 20);
+
+static void BM_Payload_SharedPayload(benchmark::State& state) {
+    size_t size = state.range(0);
+    std::vector<uint8_t> source(size, 0xAB);
+    SharedPayloadPool pool;
+
+    for (auto _ : state) {
+        SharedPayload payload = pool.copyFrom(source.data(), size);
+        SharedPayloadView view(payload.inlineData(), payload.memory());
+        benchmark::DoNotOptimize(touchPages(view.data(), view.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_Payload_SharedPayload)->RangeMultiplier(4)->Range(1 << 10, 64 << 20);
+
+// Sender writes the payload in place, without a source buffer.
+static void BM_Payload_SharedPayloadInPlace(benchmark::State& state) {
+    size_t size = state.range(0);
+    SharedPayloadPool pool;
+
+    for (auto _ : state) {
+        SharedPayload payload = pool.allocate(size);
+        memset(payload.data(), 0xAB, size);
+        SharedPayloadView view(payload.inlineData(), payload.memory());
+        benchmark::DoNotOptimize(touchPages(view.data(), view.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_Payload_SharedPayloadInPlace)->RangeMultiplier(4)->Range(1 << 10, 64 << 20);
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of streaming a payload through ChunkedStreamWriter/Reader, with the reader on
+// another thread, against copying it with memcpy.
+
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hidlstream/ChunkedStream.h>
+
+using android::hardware::ChunkedStreamReader;
+using android::hardware::ChunkedStreamWriter;
+
+static constexpr size_t kPayloadSize = 64 * 1024 * 1024;
+
+static const std::vector<uint8_t>& payload() {
+    static const std::vector<uint8_t>* payload = new std::vector<uint8_t>(kPayloadSize, 0x5a);
+    return *payload;
+}
+
+// The reader copies each chunk out, like a consumer which keeps the data.
+static void BM_ChunkedStream(benchmark::State& state) {
+    size_t chunkSize = static_cast<size_t>(state.range(0));
+    size_t credits = static_cast<size_t>(state.range(1));
+    auto writer = ChunkedStreamWriter::create(chunkSize, credits);
+    auto reader = writer == nullptr ? nullptr
+                                    : ChunkedStreamReader::create(*writer->getDesc(), chunkSize);
+    if (reader == nullptr) {
+        state.SkipWithError("could not create the stream");
+        return;
+    }
+    std::vector<uint8_t> received(kPayloadSize);
+
+    for (auto _ : state) {
+        bool ok = true;
+        std::thread reading([&] {
+            size_t offset = 0;
+            ok = reader->readAll([&](const uint8_t* data, size_t size) {
+                memcpy(received.data() + offset, data, size);
+                offset += size;
+            });
+        });
+        bool written = writer->write(payload().data(), payload().size());
+        reading.join();
+        if (!written || !ok) {
+            state.SkipWithError("streaming failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * kPayloadSize));
+    state.counters["queue_bytes"] = static_cast<double>(writer->getDesc()->getSize());
+}
+BENCHMARK(BM_ChunkedStream)
+        ->RangeMultiplier(16)
+        ->Ranges({{4 << 10, 1 << 20}, {1, 4}})
+        ->UseRealTime();
+
+static void BM_ChunkedStream_Memcpy(benchmark::State& state) {
+    std::vector<uint8_t> received(kPayloadSize);
+    for (auto _ : state) {
+        memcpy(received.data(), payload().data(), kPayloadSize);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * kPayloadSize));
+}
+BENCHMARK(BM_ChunkedStream_Memcpy)->UseRealTime();
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hidl/HidlBinderSupport.h>
+
+using android::hardware::hidl_string;
+using android::hardware::hidl_string_list;
+using android::hardware::hidl_vec;
+using android::hardware::Parcel;
+using android::hardware::readEmbeddedFromParcel;
+using android::hardware::writeEmbeddedToParcel;
+
+static std::vector<std::string> makeStrings(size_t count) {
+    std::vector<std::string> strings;
+    for (size_t i = 0; i < count; ++i) {
+        strings.push_back("android.hardware.tests.bench@1.0::IBench/instance" + std::to_string(i));
+    }
+    return strings;
+}
+
+// Builds, writes and reads back a vec<string> the way generated code does.
+static void BM_StringList_HidlVec(benchmark::State& state) {
+    std::vector<std::string> strings = makeStrings(state.range(0));
+
+    for (auto _ : state) {
+        hidl_vec<hidl_string> vec(strings.begin(), strings.end());
+
+        Parcel parcel;
+        size_t parentHandle;
+        size_t childHandle;
+        parcel.writeBuffer(&vec, sizeof(vec), &parentHandle);
+        writeEmbeddedToParcel(vec, &parcel, parentHandle, 0, &childHandle);
+        for (size_t i = 0; i < vec.size(); ++i) {
+            writeEmbeddedToParcel(vec[i], &parcel, childHandle, i * sizeof(hidl_string));
+        }
+
+        parcel.setDataPosition(0);
+        const hidl_vec<hidl_string>* received;
+        parcel.readBuffer(sizeof(*received), &parentHandle,
+                          reinterpret_cast<const void**>(&received));
+        readEmbeddedFromParcel(*received, parcel, parentHandle, 0, &childHandle);
+        for (size_t i = 0; i < received->size(); ++i) {
+            readEmbeddedFromParcel((*received)[i], parcel, childHandle, i * sizeof(hidl_string));
+        }
+        benchmark::DoNotOptimize(received);
+        state.counters["objects"] = parcel.objectsCount();
+    }
+}
+BENCHMARK(BM_StringList_HidlVec)->RangeMultiplier(10)->Range(10, 10000);
+
+static void BM_StringList_Packed(benchmark::State& state) {
+    std::vector<std::string> strings = makeStrings(state.range(0));
+
+    for (auto _ : state) {
+        hidl_string_list list(strings);
+
+        Parcel parcel;
+        size_t parentHandle;
+        parcel.writeBuffer(&list, sizeof(list), &parentHandle);
+        writeEmbeddedToParcel(list, &parcel, parentHandle, 0);
+
+        parcel.setDataPosition(0);
+        const hidl_string_list* received;
+        parcel.readBuffer(sizeof(*received), &parentHandle,
+                          reinterpret_cast<const void**>(&received));
+        readEmbeddedFromParcel(*received, parcel, parentHandle, 0);
+        benchmark::DoNotOptimize(received);
+        state.counters["objects"] = parcel.objectsCount();
+    }
+}
+BENCHMARK(BM_StringList_Packed)->RangeMultiplier(10)->Range(10, 10000);
+
+// Receiver-side cost of walking every string.
+static void BM_StringList_PackedViews(benchmark::State& state) {
+    hidl_string_list list(makeStrings(state.range(0)));
+
+    for (auto _ : state) {
+        size_t total = 0;
+        for (size_t i = 0; i < list.size(); ++i) {
+            total += list[i].size();
+        }
+        benchmark::DoNotOptimize(total);
+    }
+}
+BENCHMARK(BM_StringList_PackedViews)->RangeMultiplier(10)->Range(10, 10000);
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <hidl/HidlSupport.h>
+
+using android::hardware::hidl_string;
+using android::hardware::hidl_string_validation;
+using android::hardware::validateHidlString;
+
+static std::string makeString(size_t size, bool ascii) {
+    std::string s;
+    while (s.size() < size) {
+        s += ascii ? "android.hardware.tests.bench@1.0::IBench/default "
+                   : "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 ";
+    }
+    return s;
+}
+
+// Checks one property at a time with a byte loop, as callers do without validateHidlString.
+static hidl_string_validation scalarValidate(const char* data, size_t size) {
+    hidl_string_validation result;
+    for (size_t i = 0; i < size; ++i) {
+        if (static_cast<uint8_t>(data[i]) >= 0x80) result.isAscii = false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\0') result.hasEmbeddedNul = true;
+    }
+    for (size_t i = 0; i < size;) {
+        uint8_t c = static_cast<uint8_t>(data[i]);
+        size_t continuations = c < 0x80 ? 0 : c < 0xE0 ? 1 : c < 0xF0 ? 2 : 3;
+        if (c >= 0x80 && (c < 0xC2 || c > 0xF4)) result.isUtf8 = false;
+        for (size_t j = 1; j <= continuations; ++j) {
+            if (i + j >= size || (static_cast<uint8_t>(data[i + j]) & 0xC0) != 0x80) {
+                result.isUtf8 = false;
+            }
+        }
+        i += continuations + 1;
+    }
+    return result;
+}
+
+static void sizes(benchmark::internal::Benchmark* b) {
+    for (int64_t size : {64, 4096, 65536}) {
+        b->Args({size, 1 /* ascii */});
+        b->Args({size, 0 /* ascii */});
+    }
+}
+
+static void BM_StringValidation_Scalar(benchmark::State& state) {
+    hidl_string string = makeString(state.range(0), state.range(1));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scalarValidate(string.c_str(), string.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * string.size());
+}
+BENCHMARK(BM_StringValidation_Scalar)->Apply(sizes);
+
+static void BM_StringValidation_SinglePass(benchmark::State& state) {
+    hidl_string string = makeString(state.range(0), state.range(1));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(validateHidlString(string));
+    }
+    state.SetBytesProcessed(state.iterations() * string.size());
+}
+BENCHMARK(BM_StringValidation_SinglePass)->Apply(sizes);
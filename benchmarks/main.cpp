@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// ProcessNameBenchmark.cpp
+int processNameChildMain(const char* walk, size_t threadCount);
+
+// Unless --benchmark_out is given, results are also recorded as JSON in libhidl_benchmark.json
+// under $TMPDIR, so that the baselines of two builds can be compared, e.x. with
+// benchmark's tools/compare.py.
+static std::string defaultOutputPath() {
+    const char* dir = getenv("TMPDIR");
+    if (dir == nullptr) {
+#ifdef __ANDROID__
+        dir = "/data/local/tmp";
+#else
+        dir = "/tmp";
+#endif
+    }
+    return std::string(dir) + "/libhidl_benchmark.json";
+}
+
+static bool hasFlag(const std::vector<char*>& args, const std::string& flag) {
+    for (const char* arg : args) {
+        if (std::string(arg).rfind(flag, 0) == 0) return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    // a child started by ProcessNameBenchmark
+    if (argc == 4 && strcmp(argv[1], "--process_name_child") == 0) {
+        return processNameChildMain(argv[2], strtoul(argv[3], nullptr, 10));
+    }
+
+    std::vector<char*> args(argv, argv + argc);
+
+    std::string outputPath = defaultOutputPath();
+    std::string outputFlag = "--benchmark_out=" + outputPath;
+    std::string formatFlag = "--benchmark_out_format=json";
+    bool defaultOutput = !hasFlag(args, "--benchmark_out=");
+    if (defaultOutput) {
+        args.push_back(&outputFlag[0]);
+        if (!hasFlag(args, "--benchmark_out_format=")) {
+            args.push_back(&formatFlag[0]);
+        }
+    }
+
+    int count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+
+    if (defaultOutput) {
+        fprintf(stderr, "Results recorded in %s\n", outputPath.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hidl/AllocationCounter.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <new>
+
+namespace android {
+namespace hardware {
+
+// Innermost counter of this thread. Only touched by this thread, and initialized statically, so
+// that it is safe to use from within malloc.
+static thread_local ScopedAllocationCounter* tCounter = nullptr;
+
+ScopedAllocationCounter::ScopedAllocationCounter() : mOuter(tCounter) {
+    tCounter = this;
+}
+
+ScopedAllocationCounter::~ScopedAllocationCounter() {
+    tCounter = mOuter;
+}
+
+void countAllocation() {
+    for (ScopedAllocationCounter* counter = tCounter; counter != nullptr;
+         counter = counter->mOuter) {
+        counter->mCount++;
+    }
+}
+
+}  // namespace hardware
+}  // namespace android
+
+using android::hardware::countAllocation;
+
+// The real allocator. glibc exports it directly, since its dlsym allocates. Elsewhere (bionic,
+// musl) the next definition is looked up, which does not.
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+
+static void* realMalloc(size_t size) {
+    return __libc_malloc(size);
+}
+static void* realCalloc(size_t count, size_t size) {
+    return __libc_calloc(count, size);
+}
+static void* realRealloc(void* ptr, size_t size) {
+    return __libc_realloc(ptr, size);
+}
+static int realPosixMemalign(void** ptr, size_t alignment, size_t size) {
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr == nullptr ? ENOMEM : 0;
+}
+static void* realAlignedAlloc(size_t alignment, size_t size) {
+    return __libc_memalign(alignment, size);
+}
+#else
+template <typename F>
+static F next(const char* name) {
+    return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+
+static void* realMalloc(size_t size) {
+    static auto f = next<void* (*)(size_t)>("malloc");
+    return f(size);
+}
+static void* realCalloc(size_t count, size_t size) {
+    static auto f = next<void* (*)(size_t, size_t)>("calloc");
+    return f(count, size);
+}
+static void* realRealloc(void* ptr, size_t size) {
+    static auto f = next<void* (*)(void*, size_t)>("realloc");
+    return f(ptr, size);
+}
+static int realPosixMemalign(void** ptr, size_t alignment, size_t size) {
+    static auto f = next<int (*)(void**, size_t, size_t)>("posix_memalign");
+    return f(ptr, alignment, size);
+}
+static void* realAlignedAlloc(size_t alignment, size_t size) {
+    static auto f = next<void* (*)(size_t, size_t)>("aligned_alloc");
+    return f(alignment, size);
+}
+#endif
+
+extern "C" void* malloc(size_t size) {
+    countAllocation();
+    return realMalloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    countAllocation();
+    return realCalloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    // shrinking or freeing is not an allocation
+    if (ptr == nullptr || size > 0) countAllocation();
+    return realRealloc(ptr, size);
+}
+
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    countAllocation();
+    return realPosixMemalign(ptr, alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) {
+    countAllocation();
+    return realAlignedAlloc(alignment, size);
+}
+
+// operator new usually reaches malloc through the C++ runtime, but route it explicitly so that it
+// is counted once, whichever runtime is used.
+void* operator new(size_t size) {
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) abort();
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HIDL_ALLOCATION_COUNTER_H
+#define ANDROID_HIDL_ALLOCATION_COUNTER_H
+
+#include <stddef.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+
+/**
+ * Counts the heap allocations (malloc, calloc, realloc, posix_memalign, aligned_alloc and
+ * operator new) made by the current thread while it is alive. Counters may be nested.
+ *
+ * The allocation functions are interposed by libhidl_allocation_counter, which must be linked
+ * into the test executable with whole_static_libs.
+ */
+class ScopedAllocationCounter {
+   public:
+    ScopedAllocationCounter();
+    ~ScopedAllocationCounter();
+
+    ScopedAllocationCounter(const ScopedAllocationCounter&) = delete;
+    ScopedAllocationCounter& operator=(const ScopedAllocationCounter&) = delete;
+
+    size_t count() const { return mCount; }
+
+   private:
+    friend void countAllocation();
+
+    size_t mCount = 0;
+    ScopedAllocationCounter* mOuter;
+};
+
+// Called by the interposed allocation functions.
+void countAllocation();
+
+}  // namespace hardware
+}  // namespace android
+
+// Expects statement to make exactly expected heap allocations on this thread.
+#define EXPECT_ALLOCATIONS(expected, statement)                                   \
+    do {                                                                          \
+        size_t hidlAllocations__;                                                 \
+        {                                                                         \
+            ::android::hardware::ScopedAllocationCounter hidlCounter__;           \
+            statement;                                                            \
+            hidlAllocations__ = hidlCounter__.count();                            \
+        }                                                                         \
+        EXPECT_EQ(static_cast<size_t>(expected), hidlAllocations__) << #statement; \
+    } while (0)
+
+#define EXPECT_NO_ALLOCATIONS(statement) EXPECT_ALLOCATIONS(0, statement)
+
+#endif  // ANDROID_HIDL_ALLOCATION_COUNTER_H
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libhidlmemory"
+
+#include <hidlmemory/SharedPayload.h>
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <map>
+#include <mutex>
+
+#include <android-base/logging.h>
+#include <cutils/ashmem.h>
+#include <cutils/native_handle.h>
+
+namespace android {
+namespace hardware {
+
+namespace details {
+
+struct SharedPayloadRegion {
+    native_handle_t* handle;
+    void* address;
+    size_t capacity;
+};
+
+static void destroyRegion(SharedPayloadRegion* region) {
+    munmap(region->address, region->capacity);
+    native_handle_close(region->handle);
+    native_handle_delete(region->handle);
+    delete region;
+}
+
+class SharedPayloadPoolImpl : public std::enable_shared_from_this<SharedPayloadPoolImpl> {
+   public:
+    SharedPayloadPoolImpl(size_t inlineThreshold, size_t maxPooledBytes)
+        : mInlineThreshold(inlineThreshold), mMaxPooledBytes(maxPooledBytes) {}
+
+    ~SharedPayloadPoolImpl() {
+        for (auto& [capacity, region] : mFree) {
+            destroyRegion(region);
+        }
+    }
+
+    SharedPayload allocate(size_t size) {
+        SharedPayload payload;
+        payload.mSize = size;
+
+        if (size <= mInlineThreshold) {
+            payload.mInlineData.resize(size);
+            payload.mValid = true;
+            return payload;
+        }
+
+        SharedPayloadRegion* region = takeRegion(capacityFor(size));
+        if (region == nullptr) {
+            return payload;
+        }
+
+        payload.mRegion = region;
+        payload.mPool = shared_from_this();
+        payload.mMemory = hidl_memory("ashmem", region->handle, size);
+        payload.mValid = true;
+        return payload;
+    }
+
+    void release(SharedPayloadRegion* region) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mPooledBytes + region->capacity <= mMaxPooledBytes) {
+                mPooledBytes += region->capacity;
+                mFree.emplace(region->capacity, region);
+                return;
+            }
+        }
+        destroyRegion(region);
+    }
+
+   private:
+    static size_t capacityFor(size_t size) {
+        size_t capacity = static_cast<size_t>(getpagesize());
+        while (capacity < size) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    SharedPayloadRegion* takeRegion(size_t capacity) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mFree.find(capacity);
+            if (it != mFree.end()) {
+                SharedPayloadRegion* region = it->second;
+                mFree.erase(it);
+                mPooledBytes -= capacity;
+                return region;
+            }
+        }
+
+        int fd = ashmem_create_region("SharedPayload", capacity);
+        if (fd < 0) {
+            PLOG(ERROR) << "Could not create a " << capacity << " byte region";
+            return nullptr;
+        }
+
+        void* address = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            PLOG(ERROR) << "Could not map a " << capacity << " byte region";
+            close(fd);
+            return nullptr;
+        }
+
+        // Only this mapping may write to the region, so that receivers, which keep its fd if
+        // they want to, cannot change what is sent through it later.
+        if (ashmem_set_prot_region(fd, PROT_READ) != 0) {
+            PLOG(ERROR) << "Could not make a " << capacity << " byte region read-only";
+            munmap(address, capacity);
+            close(fd);
+            return nullptr;
+        }
+
+        native_handle_t* handle = native_handle_create(1 /* numFds */, 0 /* numInts */);
+        handle->data[0] = fd;
+        return new SharedPayloadRegion{handle, address, capacity};
+    }
+
+    const size_t mInlineThreshold;
+    const size_t mMaxPooledBytes;
+
+    std::mutex mMutex;
+    size_t mPooledBytes = 0;
+    std::multimap<size_t, SharedPayloadRegion*> mFree;
+};
+
+}  // namespace details
+
+SharedPayload::SharedPayload() {}
+
+SharedPayload::SharedPayload(SharedPayload&& other) noexcept {
+    *this = std::move(other);
+}
+
+SharedPayload& SharedPayload::operator=(SharedPayload&& other) noexcept {
+    if (this != &other) {
+        release();
+        mValid = other.mValid;
+        mSize = other.mSize;
+        mInlineData = std::move(other.mInlineData);
+        mMemory = std::move(other.mMemory);
+        mPool = std::move(other.mPool);
+        mRegion = other.mRegion;
+
+        other.mValid = false;
+        other.mSize = 0;
+        other.mRegion = nullptr;
+    }
+    return *this;
+}
+
+SharedPayload::~SharedPayload() {
+    release();
+}
+
+void SharedPayload::release() {
+    if (mRegion != nullptr) {
+        // Drop the reference to the region's handle before the pool reuses it.
+        mMemory = hidl_memory();
+        mPool->release(mRegion);
+        mRegion = nullptr;
+        mPool = nullptr;
+    }
+}
+
+uint8_t* SharedPayload::data() {
+    if (mRegion != nullptr) {
+        return static_cast<uint8_t*>(mRegion->address);
+    }
+    return mInlineData.data();
+}
+
+SharedPayloadPool::SharedPayloadPool(size_t inlineThreshold, size_t maxPooledBytes)
+    : mImpl(std::make_shared<details::SharedPayloadPoolImpl>(inlineThreshold, maxPooledBytes)) {}
+
+SharedPayloadPool::~SharedPayloadPool() {}
+
+SharedPayload SharedPayloadPool::allocate(size_t size) {
+    return mImpl->allocate(size);
+}
+
+SharedPayload SharedPayloadPool::copyFrom(const void* data, size_t size) {
+    SharedPayload payload = mImpl->allocate(size);
+    if (payload.valid() && size > 0) {
+        memcpy(payload.data(), data, size);
+    }
+    return payload;
+}
+
+SharedPayloadView::SharedPayloadView(const hidl_vec<uint8_t>& inlineData,
+                                     const hidl_memory& memory) {
+    if (!memory.valid()) {
+        mData = inlineData.data();
+        mSize = inlineData.size();
+        mValid = true;
+        return;
+    }
+
+    // hidl_memory's size is stored in uint64_t, but mmap maps size_t bytes.
+    if (memory.size() > SIZE_MAX) {
+        LOG(ERROR) << "Cannot map " << memory.size() << " bytes of memory because it is too large.";
+        return;
+    }
+
+    if (memory.name() != "ashmem") {
+        LOG(ERROR) << "Shared payload is in " << memory.name() << " memory, not ashmem.";
+        return;
+    }
+
+    const native_handle_t* handle = memory.handle();
+    if (handle->numFds < 1) {
+        LOG(ERROR) << "Shared payload handle has no file descriptor.";
+        return;
+    }
+
+    if (memory.size() == 0) {
+        mValid = true;
+        return;
+    }
+
+    // The sender controls both the size and the region, and accessing a mapping past the end of
+    // the region would raise SIGBUS.
+    int regionSize = ashmem_get_size_region(handle->data[0]);
+    if (regionSize < 0 || static_cast<uint64_t>(regionSize) < memory.size()) {
+        LOG(ERROR) << "Shared payload of " << memory.size() << " bytes is not in an ashmem region "
+                   << "of at least that size (" << regionSize << ").";
+        return;
+    }
+
+    mSize = static_cast<size_t>(memory.size());
+
+    void* address = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, handle->data[0], 0);
+    if (address == MAP_FAILED) {
+        PLOG(ERROR) << "Could not map shared payload of " << mSize << " bytes";
+        mSize = 0;
+        return;
+    }
+
+    mMapping = address;
+    mData = static_cast<const uint8_t*>(address);
+    mValid = true;
+}
+
+SharedPayloadView::~SharedPayloadView() {
+    if (mMapping != nullptr) {
+        munmap(mMapping, mSize);
+    }
+}
+
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ANDROID_HARDWARE_SHARED_PAYLOAD_H
+#define ANDROID_HARDWARE_SHARED_PAYLOAD_H
+
+#include <memory>
+
+#include <hidl/HidlSupport.h>
+
+namespace android {
+namespace hardware {
+
+namespace details {
+struct SharedPayloadRegion;
+class SharedPayloadPoolImpl;
+}  // namespace details
+
+/**
+ * A byte payload which is sent inline in a hidl_vec<uint8_t> when it is small, and in an ashmem
+ * region passed as a hidl_memory when it is not. Large payloads are then neither copied into the
+ * binder buffer nor limited by its size. An interface carries both fields, for instance:
+ *
+ *     struct Payload {
+ *         vec<uint8_t> inlineData;
+ *         memory sharedData;
+ *     };
+ *
+ * The sender fills them from inlineData() and memory(), and the receiver reads them back
+ * with SharedPayloadView.
+ *
+ * Regions come from a SharedPayloadPool and go back to it when the SharedPayload is destroyed.
+ * Keep it alive until the receiver is done with the data (e.g. until a synchronous call
+ * returns). Regions are read-only to receivers, but a receiver which keeps one may read what
+ * later payloads reusing it hold, so use separate pools for peers which must not see each
+ * other's data.
+ */
+class SharedPayload {
+   public:
+    SharedPayload();
+    SharedPayload(SharedPayload&& other) noexcept;
+    SharedPayload& operator=(SharedPayload&& other) noexcept;
+    ~SharedPayload();
+
+    SharedPayload(const SharedPayload&) = delete;
+    SharedPayload& operator=(const SharedPayload&) = delete;
+
+    // false if the pool failed to allocate a region.
+    bool valid() const { return mValid; }
+    // true if the contents are in a shared memory region.
+    bool isShared() const { return mRegion != nullptr; }
+
+    // Writable contents, to be filled before sending.
+    uint8_t* data();
+    size_t size() const { return mSize; }
+
+    // The fields to send. Exactly one of them is non-empty.
+    const hidl_vec<uint8_t>& inlineData() const { return mInlineData; }
+    const hidl_memory& memory() const { return mMemory; }
+
+   private:
+    friend class details::SharedPayloadPoolImpl;
+
+    void release();
+
+    bool mValid = false;
+    size_t mSize = 0;
+    hidl_vec<uint8_t> mInlineData;
+    hidl_memory mMemory;
+    std::shared_ptr<details::SharedPayloadPoolImpl> mPool;
+    details::SharedPayloadRegion* mRegion = nullptr;
+};
+
+/**
+ * Hands out SharedPayloads, keeping the regions of released ones mapped for reuse. Regions are
+ * sized in powers of two, and at most maxPooledBytes of unused regions are kept.
+ *
+ * Thread-safe. Payloads may outlive their pool.
+ */
+class SharedPayloadPool {
+   public:
+    static constexpr size_t kDefaultInlineThreshold = 16 * 1024;
+    static constexpr size_t kDefaultMaxPooledBytes = 64 * 1024 * 1024;
+
+    explicit SharedPayloadPool(size_t inlineThreshold = kDefaultInlineThreshold,
+                               size_t maxPooledBytes = kDefaultMaxPooledBytes);
+    ~SharedPayloadPool();
+
+    // Returns a payload of size bytes, to be filled through data().
+    SharedPayload allocate(size_t size);
+
+    // Returns a payload holding a copy of data.
+    SharedPayload copyFrom(const void* data, size_t size);
+
+   private:
+    std::shared_ptr<details::SharedPayloadPoolImpl> mImpl;
+};
+
+/**
+ * Read-only access to a payload received as a (hidl_vec<uint8_t>, hidl_memory) pair. Shared
+ * regions are mapped directly, and inline data is referenced without copying, so the arguments
+ * must outlive the view. A shared region is only mapped if it is ashmem at least as large as the
+ * payload.
+ */
+class SharedPayloadView {
+   public:
+    SharedPayloadView(const hidl_vec<uint8_t>& inlineData, const hidl_memory& memory);
+    ~SharedPayloadView();
+
+    SharedPayloadView(const SharedPayloadView&) = delete;
+    SharedPayloadView& operator=(const SharedPayloadView&) = delete;
+
+    // false if the shared region could not be mapped.
+    bool valid() const { return mValid; }
+    const uint8_t* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+   private:
+    bool mValid = false;
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+    void* mMapping = nullptr;
+};
+
+}  // namespace hardware
+}  // namespace android
+#endif
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libhidlstream"
+
+#include <hidlstream/ChunkedStream.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+
+namespace android {
+namespace hardware {
+
+// Each chunk takes a slot of kHeaderSize + chunkSize bytes. The queue holds a whole number of
+// slots and is always written and read a slot at a time, so slots never wrap around its end.
+struct ChunkHeader {
+    uint32_t size;
+    uint32_t flags;
+};
+static constexpr size_t kHeaderSize = sizeof(ChunkHeader);
+static constexpr uint32_t kFlagLast = 1 << 0;
+
+// event flag bits
+static constexpr uint32_t kChunkWritten = 1 << 0;
+static constexpr uint32_t kChunkRead = 1 << 1;
+
+static size_t slotSize(size_t chunkSize) {
+    // keeps headers aligned
+    return kHeaderSize + (chunkSize + alignof(ChunkHeader) - 1) / alignof(ChunkHeader) *
+                                 alignof(ChunkHeader);
+}
+
+static EventFlag* createEventFlag(ChunkedStreamWriter::Queue* queue) {
+    EventFlag* eventFlag = nullptr;
+    if (EventFlag::createEventFlag(queue->getEventFlagWord(), &eventFlag) != OK) {
+        LOG(ERROR) << "Could not create the stream's event flag";
+        return nullptr;
+    }
+    return eventFlag;
+}
+
+// Waits until available() is at least size, or the timeout expires.
+template <typename Available>
+static bool waitFor(EventFlag* eventFlag, uint32_t bit, size_t size, int64_t timeoutNanos,
+                    const Available& available) {
+    // The flag's bits stay set until a wait returns them, so a wake between the check and the
+    // wait is not lost.
+    while (available() < size) {
+        uint32_t state = 0;
+        status_t status = eventFlag->wait(bit, &state, timeoutNanos);
+        if (status == TIMED_OUT) return false;
+        if (status != OK && status != -EINTR && status != -EAGAIN) {
+            LOG(ERROR) << "Waiting on the stream failed: " << status;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<ChunkedStreamWriter> ChunkedStreamWriter::create(size_t chunkSize,
+                                                                 size_t credits) {
+    if (chunkSize == 0 || chunkSize > UINT32_MAX || credits == 0 ||
+        slotSize(chunkSize) > SIZE_MAX / credits) {
+        LOG(ERROR) << "Invalid stream of " << credits << " chunks of " << chunkSize << " bytes";
+        return nullptr;
+    }
+
+    auto queue = std::make_unique<Queue>(slotSize(chunkSize) * credits,
+                                         true /* configureEventFlagWord */);
+    if (!queue->isValid()) {
+        LOG(ERROR) << "Could not create the stream's queue";
+        return nullptr;
+    }
+    EventFlag* eventFlag = createEventFlag(queue.get());
+    if (eventFlag == nullptr) return nullptr;
+
+    return std::unique_ptr<ChunkedStreamWriter>(
+            new ChunkedStreamWriter(std::move(queue), eventFlag, chunkSize));
+}
+
+ChunkedStreamWriter::ChunkedStreamWriter(std::unique_ptr<Queue> queue, EventFlag* eventFlag,
+                                         size_t chunkSize)
+    : mQueue(std::move(queue)), mEventFlag(eventFlag), mChunkSize(chunkSize) {}
+
+ChunkedStreamWriter::~ChunkedStreamWriter() {
+    EventFlag::deleteEventFlag(&mEventFlag);
+}
+
+bool ChunkedStreamWriter::writeChunk(
+        const std::function<size_t(uint8_t* buffer, size_t capacity)>& fill, bool last,
+        int64_t timeoutNanos) {
+    size_t slot = slotSize(mChunkSize);
+    if (!waitFor(mEventFlag, kChunkRead, slot, timeoutNanos,
+                 [this] { return mQueue->availableToWrite(); })) {
+        return false;
+    }
+
+    Queue::MemTransaction transaction;
+    if (!mQueue->beginWrite(slot, &transaction) ||
+        transaction.getFirstRegion().getLength() != slot) {
+        LOG(ERROR) << "Stream slot is not contiguous";
+        return false;
+    }
+    uint8_t* address = transaction.getFirstRegion().getAddress();
+
+    size_t size = fill(address + kHeaderSize, mChunkSize);
+    CHECK_LE(size, mChunkSize) << "Chunk overflows its buffer";
+    ChunkHeader header = {static_cast<uint32_t>(size), last ? kFlagLast : 0};
+    memcpy(address, &header, sizeof(header));
+
+    if (!mQueue->commitWrite(slot)) return false;
+    mEventFlag->wake(kChunkWritten);
+    return true;
+}
+
+bool ChunkedStreamWriter::write(const void* data, size_t size, int64_t timeoutNanos) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    // an empty payload is still one (empty) last chunk
+    do {
+        size_t chunk = std::min(size, mChunkSize);
+        bool last = chunk == size;
+        if (!writeChunk(
+                    [&](uint8_t* buffer, size_t) {
+                        if (chunk > 0) memcpy(buffer, bytes, chunk);
+                        return chunk;
+                    },
+                    last, timeoutNanos)) {
+            return false;
+        }
+        bytes += chunk;
+        size -= chunk;
+    } while (size > 0);
+    return true;
+}
+
+std::unique_ptr<ChunkedStreamReader> ChunkedStreamReader::create(const Queue::Descriptor& desc,
+                                                                 size_t chunkSize) {
+    if (chunkSize == 0 || chunkSize > UINT32_MAX || desc.getSize() == 0 ||
+        desc.getSize() % slotSize(chunkSize) != 0) {
+        LOG(ERROR) << "Stream queue does not hold chunks of " << chunkSize << " bytes";
+        return nullptr;
+    }
+
+    auto queue = std::make_unique<Queue>(desc, false /* resetPointers */);
+    if (!queue->isValid() || queue->getEventFlagWord() == nullptr) {
+        LOG(ERROR) << "Invalid stream queue";
+        return nullptr;
+    }
+    EventFlag* eventFlag = createEventFlag(queue.get());
+    if (eventFlag == nullptr) return nullptr;
+
+    return std::unique_ptr<ChunkedStreamReader>(
+            new ChunkedStreamReader(std::move(queue), eventFlag, chunkSize));
+}
+
+ChunkedStreamReader::ChunkedStreamReader(std::unique_ptr<Queue> queue, EventFlag* eventFlag,
+                                         size_t chunkSize)
+    : mQueue(std::move(queue)), mEventFlag(eventFlag), mChunkSize(chunkSize) {}
+
+ChunkedStreamReader::~ChunkedStreamReader() {
+    EventFlag::deleteEventFlag(&mEventFlag);
+}
+
+bool ChunkedStreamReader::readChunk(
+        const std::function<void(const uint8_t* data, size_t size)>& process, bool* last,
+        int64_t timeoutNanos) {
+    size_t slot = slotSize(mChunkSize);
+    if (!waitFor(mEventFlag, kChunkWritten, slot, timeoutNanos,
+                 [this] { return mQueue->availableToRead(); })) {
+        return false;
+    }
+
+    Queue::MemTransaction transaction;
+    if (!mQueue->beginRead(slot, &transaction) ||
+        transaction.getFirstRegion().getLength() != slot) {
+        LOG(ERROR) << "Stream slot is not contiguous";
+        return false;
+    }
+    const uint8_t* address = transaction.getFirstRegion().getAddress();
+
+    // the writer is another process, so the header is not trusted
+    ChunkHeader header;
+    memcpy(&header, address, sizeof(header));
+    if (header.size > mChunkSize || (header.flags & ~kFlagLast) != 0) {
+        LOG(ERROR) << "Malformed stream chunk of " << header.size << " bytes";
+        return false;
+    }
+
+    process(address + kHeaderSize, header.size);
+    *last = (header.flags & kFlagLast) != 0;
+
+    if (!mQueue->commitRead(slot)) return false;
+    mEventFlag->wake(kChunkRead);
+    return true;
+}
+
+bool ChunkedStreamReader::readAll(
+        const std::function<void(const uint8_t* data, size_t size)>& process,
+        int64_t timeoutNanos) {
+    bool last = false;
+    while (!last) {
+        if (!readChunk(process, &last, timeoutNanos)) return false;
+    }
+    return true;
+}
+
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_CHUNKED_STREAM_H
+#define ANDROID_HARDWARE_CHUNKED_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+
+#include <fmq/EventFlag.h>
+#include <fmq/MessageQueue.h>
+
+namespace android {
+namespace hardware {
+
+/**
+ * Streams a payload of any size over a synchronized fast message queue, in chunks of at most
+ * chunkSize bytes. The queue has room for a fixed number of chunks (the writer's credits): the
+ * writer fills chunks in place while it has credits, and each chunk the reader is done with
+ * returns one. Memory use is bounded by chunkSize * credits, and with two or more credits the
+ * reader processes a chunk while the writer fills the next.
+ *
+ * The writer creates the queue and sends getDesc() to the reader, e.x. as an fmq_sync<uint8_t>
+ * argument of a HIDL call, along with the chunk size. The two sides wake each other through the
+ * queue's event flag word.
+ *
+ * Each side must be used from one thread at a time.
+ */
+class ChunkedStreamWriter {
+   public:
+    using Queue = MessageQueue<uint8_t, kSynchronizedReadWrite>;
+
+    // Returns nullptr if the queue could not be created.
+    static std::unique_ptr<ChunkedStreamWriter> create(size_t chunkSize, size_t credits);
+    ~ChunkedStreamWriter();
+
+    ChunkedStreamWriter(const ChunkedStreamWriter&) = delete;
+    ChunkedStreamWriter& operator=(const ChunkedStreamWriter&) = delete;
+
+    const Queue::Descriptor* getDesc() const { return mQueue->getDesc(); }
+    size_t chunkSize() const { return mChunkSize; }
+
+    // Waits up to timeoutNanos (0: forever) for a credit, then calls fill with the next chunk's
+    // buffer and chunkSize(). fill returns the number of bytes it wrote. If last, the chunk ends
+    // the stream. Returns false on timeout or error.
+    bool writeChunk(const std::function<size_t(uint8_t* buffer, size_t capacity)>& fill, bool last,
+                    int64_t timeoutNanos = 0);
+
+    // Copies size bytes into as many chunks as needed, the last of which ends the stream.
+    bool write(const void* data, size_t size, int64_t timeoutNanos = 0);
+
+   private:
+    ChunkedStreamWriter(std::unique_ptr<Queue> queue, EventFlag* eventFlag, size_t chunkSize);
+
+    std::unique_ptr<Queue> mQueue;
+    EventFlag* mEventFlag;
+    const size_t mChunkSize;
+};
+
+class ChunkedStreamReader {
+   public:
+    using Queue = ChunkedStreamWriter::Queue;
+
+    // chunkSize must be the writer's. Returns nullptr if desc is not a valid stream.
+    static std::unique_ptr<ChunkedStreamReader> create(const Queue::Descriptor& desc,
+                                                       size_t chunkSize);
+    ~ChunkedStreamReader();
+
+    ChunkedStreamReader(const ChunkedStreamReader&) = delete;
+    ChunkedStreamReader& operator=(const ChunkedStreamReader&) = delete;
+
+    // Waits up to timeoutNanos (0: forever) for a chunk, then calls process with its contents in
+    // the queue, and returns its credit to the writer. Sets last if the chunk ends the stream.
+    // Returns false on timeout, or if the writer sent a malformed chunk.
+    bool readChunk(const std::function<void(const uint8_t* data, size_t size)>& process,
+                   bool* last, int64_t timeoutNanos = 0);
+
+    // Calls readChunk until the end of the stream.
+    bool readAll(const std::function<void(const uint8_t* data, size_t size)>& process,
+                 int64_t timeoutNanos = 0);
+
+   private:
+    ChunkedStreamReader(std::unique_ptr<Queue> queue, EventFlag* eventFlag, size_t chunkSize);
+
+    std::unique_ptr<Queue> mQueue;
+    EventFlag* mEventFlag;
+    const size_t mChunkSize;
+};
+
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_CHUNKED_STREAM_H
@@ -14,16 +14,25 @@
 // limitations under the License.
 //
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <libminijail.h>
 
 #include <hwminijail/HardwareMinijail.h>
 
+#include "PrecompiledPolicy.h"
+
 namespace android {
 namespace hardware {
 
 void SetupMinijail(const std::string& seccomp_policy_path) {
-    if (access(seccomp_policy_path.c_str(), R_OK) == -1) {
+    SetupMinijail(seccomp_policy_path, seccomp_policy_path + ".bpf");
+}
+
+void SetupMinijail(const std::string& seccomp_policy_path, const std::string& seccomp_bpf_path) {
+    // The policy is read even when a precompiled program exists, to check that it is current.
+    std::string policy;
+    if (!base::ReadFileToString(seccomp_policy_path, &policy)) {
         LOG(WARNING) << "Could not find seccomp policy file at: " << seccomp_policy_path;
         return;
     }
@@ -34,9 +43,18 @@ void SetupMinijail(const std::string& seccomp_policy_path) {
     }
 
     minijail_no_new_privs(jail);
-    minijail_log_seccomp_filter_failures(jail);
     minijail_use_seccomp_filter(jail);
-    minijail_parse_seccomp_filters(jail, seccomp_policy_path.c_str());
+
+    std::vector<sock_filter> program;
+    if (details::ReadPrecompiledPolicy(policy, seccomp_bpf_path, &program)) {
+        // The program logs failures itself, minijail rejects logging them for set filters.
+        struct sock_fprog fprog = {static_cast<unsigned short>(program.size()), program.data()};
+        minijail_set_seccomp_filters(jail, &fprog);
+    } else {
+        minijail_log_seccomp_filter_failures(jail);
+        minijail_parse_seccomp_filters(jail, seccomp_policy_path.c_str());
+    }
+
     minijail_enter(jail);
     minijail_destroy(jail);
 }
@@ -0,0 +1,137 @@
+//
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Compares the two ways SetupMinijail builds a jail, stopping before minijail_enter so that the
+// benchmark itself is not sandboxed.
+
+#include <linux/seccomp.h>
+#include <stddef.h>
+#include <sys/syscall.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+#include <libminijail.h>
+
+#include "PrecompiledPolicy.h"
+
+using android::hardware::details::ReadPrecompiledPolicy;
+using android::hardware::details::WritePrecompiledPolicy;
+
+// A policy of typical size for a HAL which only serves binder calls.
+static const std::vector<std::pair<const char*, int>> kSyscalls = {
+        {"read", __NR_read},
+        {"write", __NR_write},
+        {"writev", __NR_writev},
+        {"close", __NR_close},
+        {"openat", __NR_openat},
+        {"faccessat", __NR_faccessat},
+        {"lseek", __NR_lseek},
+        {"ioctl", __NR_ioctl},
+        {"dup3", __NR_dup3},
+        {"pipe2", __NR_pipe2},
+        {"epoll_pwait", __NR_epoll_pwait},
+        {"futex", __NR_futex},
+        {"brk", __NR_brk},
+        {"munmap", __NR_munmap},
+        {"mprotect", __NR_mprotect},
+        {"madvise", __NR_madvise},
+        {"prctl", __NR_prctl},
+        {"getpid", __NR_getpid},
+        {"gettid", __NR_gettid},
+        {"getrandom", __NR_getrandom},
+        {"clock_gettime", __NR_clock_gettime},
+        {"nanosleep", __NR_nanosleep},
+        {"sched_yield", __NR_sched_yield},
+        {"rt_sigprocmask", __NR_rt_sigprocmask},
+        {"rt_sigreturn", __NR_rt_sigreturn},
+        {"exit_group", __NR_exit_group},
+};
+
+// The program minijail compiles from kSyscalls with failure logging, modulo its ordering of the
+// comparisons.
+static std::vector<sock_filter> compileSampleProgram() {
+    std::vector<sock_filter> program;
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)));
+    for (const auto& [name, nr] : kSyscalls) {
+        program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(nr), 0, 1));
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    }
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_LOG));
+    return program;
+}
+
+class SamplePolicy {
+   public:
+    SamplePolicy() {
+        for (const auto& [name, nr] : kSyscalls) {
+            mPolicy += std::string(name) + ": 1\n";
+        }
+        mPolicyPath = std::string(mDir.path) + "/sample.policy";
+        mBpfPath = mPolicyPath + ".bpf";
+        android::base::WriteStringToFile(mPolicy, mPolicyPath);
+        WritePrecompiledPolicy(mPolicy, compileSampleProgram(), mBpfPath);
+    }
+
+    const std::string& policyPath() const { return mPolicyPath; }
+    const std::string& bpfPath() const { return mBpfPath; }
+
+   private:
+    TemporaryDir mDir;
+    std::string mPolicy;
+    std::string mPolicyPath;
+    std::string mBpfPath;
+};
+
+static void BM_SetupMinijail_ParsePolicy(benchmark::State& state) {
+    SamplePolicy sample;
+    for (auto _ : state) {
+        struct minijail* jail = minijail_new();
+        minijail_no_new_privs(jail);
+        minijail_use_seccomp_filter(jail);
+        minijail_log_seccomp_filter_failures(jail);
+        minijail_parse_seccomp_filters(jail, sample.policyPath().c_str());
+        minijail_destroy(jail);
+    }
+}
+BENCHMARK(BM_SetupMinijail_ParsePolicy);
+
+static void BM_SetupMinijail_Precompiled(benchmark::State& state) {
+    SamplePolicy sample;
+    for (auto _ : state) {
+        struct minijail* jail = minijail_new();
+        minijail_no_new_privs(jail);
+        minijail_use_seccomp_filter(jail);
+
+        std::string policy;
+        std::vector<sock_filter> program;
+        android::base::ReadFileToString(sample.policyPath(), &policy);
+        if (!ReadPrecompiledPolicy(policy, sample.bpfPath(), &program)) {
+            state.SkipWithError("could not read the precompiled policy");
+            minijail_destroy(jail);
+            break;
+        }
+        struct sock_fprog fprog = {static_cast<unsigned short>(program.size()), program.data()};
+        minijail_set_seccomp_filters(jail, &fprog);
+        minijail_destroy(jail);
+    }
+}
+BENCHMARK(BM_SetupMinijail_Precompiled);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,135 @@
+//
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "PrecompiledPolicy.h"
+
+#include <linux/seccomp.h>
+#include <string.h>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+uint64_t HashSeccompPolicy(const std::string& policy) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : policy) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool PolicyHasIncludes(const std::string& policy) {
+    size_t start = 0;
+    while (start < policy.size()) {
+        size_t end = policy.find('\n', start);
+        if (end == std::string::npos) end = policy.size();
+        size_t first = policy.find_first_not_of(" \t", start);
+        if (first < end && policy.compare(first, strlen("@include"), "@include") == 0) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+bool ProgramLogsFailures(const std::vector<sock_filter>& program) {
+    for (const sock_filter& filter : program) {
+        if (filter.code == (BPF_RET | BPF_K) &&
+            (filter.k & SECCOMP_RET_ACTION) == SECCOMP_RET_LOG) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WritePrecompiledPolicy(const std::string& policy, const std::vector<sock_filter>& program,
+                            const std::string& path) {
+    PrecompiledPolicyHeader header;
+    memcpy(header.magic, kPrecompiledPolicyMagic, sizeof(header.magic));
+    header.version = kPrecompiledPolicyVersion;
+    header.filterCount = static_cast<uint32_t>(program.size());
+    header.policyHash = HashSeccompPolicy(policy);
+
+    std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    contents.append(reinterpret_cast<const char*>(program.data()),
+                    program.size() * sizeof(sock_filter));
+
+    if (!base::WriteStringToFile(contents, path)) {
+        PLOG(ERROR) << "Could not write precompiled seccomp policy to " << path;
+        return false;
+    }
+    return true;
+}
+
+bool ReadPrecompiledPolicy(const std::string& policy, const std::string& path,
+                           std::vector<sock_filter>* program) {
+    std::string contents;
+    if (!base::ReadFileToString(path, &contents)) {
+        // not an error, precompiling is optional
+        return false;
+    }
+
+    PrecompiledPolicyHeader header;
+    if (contents.size() < sizeof(header)) {
+        LOG(WARNING) << "Precompiled seccomp policy " << path << " is truncated.";
+        return false;
+    }
+    memcpy(&header, contents.data(), sizeof(header));
+
+    if (memcmp(header.magic, kPrecompiledPolicyMagic, sizeof(header.magic)) != 0 ||
+        header.version != kPrecompiledPolicyVersion) {
+        LOG(WARNING) << "Precompiled seccomp policy " << path << " has an unknown format.";
+        return false;
+    }
+
+    if (header.filterCount == 0 || header.filterCount > BPF_MAXINSNS ||
+        contents.size() != sizeof(header) + header.filterCount * sizeof(sock_filter)) {
+        LOG(WARNING) << "Precompiled seccomp policy " << path << " has a bad program size.";
+        return false;
+    }
+
+    if (header.policyHash != HashSeccompPolicy(policy)) {
+        LOG(WARNING) << "Precompiled seccomp policy " << path
+                     << " is stale, parsing the policy instead.";
+        return false;
+    }
+
+    if (PolicyHasIncludes(policy)) {
+        LOG(WARNING) << "Precompiled seccomp policy " << path
+                     << " is for a policy including others, parsing the policy instead.";
+        return false;
+    }
+
+    std::vector<sock_filter> filters(header.filterCount);
+    memcpy(filters.data(), contents.data() + sizeof(header),
+           header.filterCount * sizeof(sock_filter));
+    if (!ProgramLogsFailures(filters)) {
+        LOG(WARNING) << "Precompiled seccomp policy " << path
+                     << " does not log failures, parsing the policy instead.";
+        return false;
+    }
+
+    *program = std::move(filters);
+    return true;
+}
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,72 @@
+//
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ANDROID_HARDWARE_MINIJAIL_PRECOMPILED_POLICY_H
+#define ANDROID_HARDWARE_MINIJAIL_PRECOMPILED_POLICY_H
+
+#include <linux/filter.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+// A precompiled seccomp policy is this header followed by filterCount sock_filters, which are the
+// BPF program minijail compiles from the policy (e.x. with minijail_compile_seccomp_policy). The
+// hash of the policy text it was compiled from is recorded so that a stale program is never
+// installed in place of an updated policy. Only the policy file itself is hashed, so policies
+// which @include others are not precompiled.
+//
+// minijail cannot log the failures of a program it did not compile, so the program must be
+// compiled to log them itself, i.e. to return SECCOMP_RET_LOG for syscalls the policy does not
+// allow, as minijail_log_seccomp_filter_failures does.
+struct PrecompiledPolicyHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t filterCount;
+    uint64_t policyHash;
+};
+
+constexpr char kPrecompiledPolicyMagic[8] = {'H', 'W', 'M', 'J', 'B', 'P', 'F', '\0'};
+constexpr uint32_t kPrecompiledPolicyVersion = 1;
+
+// FNV-1a hash of the policy text. This detects stale programs, it is not a security boundary:
+// policies and their programs are installed on the same read-only partition.
+uint64_t HashSeccompPolicy(const std::string& policy);
+
+// Whether policy includes other policy files, whose contents would not be covered by its hash.
+bool PolicyHasIncludes(const std::string& policy);
+
+// Whether program logs the syscalls it does not allow.
+bool ProgramLogsFailures(const std::vector<sock_filter>& program);
+
+// Writes program, compiled from policy, to path. Returns false on failure.
+bool WritePrecompiledPolicy(const std::string& policy, const std::vector<sock_filter>& program,
+                            const std::string& path);
+
+// Reads the program at path if it is well-formed and was compiled from policy. Returns false,
+// logging why, otherwise.
+bool ReadPrecompiledPolicy(const std::string& policy, const std::string& path,
+                           std::vector<sock_filter>* program);
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_MINIJAIL_PRECOMPILED_POLICY_H
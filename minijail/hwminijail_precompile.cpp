@@ -0,0 +1,76 @@
+//
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Packages the BPF program minijail compiled from a seccomp policy so that SetupMinijail can
+// install it without parsing the policy, e.x. in a genrule:
+//
+//     minijail_compile_seccomp_policy --arch-json $(arch_json) --use-ret-log \
+//             foo.policy foo.raw.bpf
+//     hwminijail_precompile foo.policy foo.raw.bpf foo.policy.bpf
+//
+// The program must log the syscalls it does not allow, since SetupMinijail cannot ask minijail to
+// log them for a precompiled program. Policies which @include others cannot be precompiled.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+
+#include "PrecompiledPolicy.h"
+
+using android::hardware::details::PolicyHasIncludes;
+using android::hardware::details::ProgramLogsFailures;
+using android::hardware::details::WritePrecompiledPolicy;
+
+int main(int argc, char** argv) {
+    android::base::InitLogging(argv);
+
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <policy> <compiled bpf> <output>\n", argv[0]);
+        return 1;
+    }
+
+    std::string policy;
+    if (!android::base::ReadFileToString(argv[1], &policy)) {
+        PLOG(ERROR) << "Could not read " << argv[1];
+        return 1;
+    }
+    if (PolicyHasIncludes(policy)) {
+        LOG(ERROR) << argv[1] << " includes other policies, so it cannot be precompiled.";
+        return 1;
+    }
+
+    std::string compiled;
+    if (!android::base::ReadFileToString(argv[2], &compiled)) {
+        PLOG(ERROR) << "Could not read " << argv[2];
+        return 1;
+    }
+    if (compiled.empty() || compiled.size() % sizeof(sock_filter) != 0 ||
+        compiled.size() / sizeof(sock_filter) > BPF_MAXINSNS) {
+        LOG(ERROR) << argv[2] << " is not a BPF program.";
+        return 1;
+    }
+
+    std::vector<sock_filter> program(compiled.size() / sizeof(sock_filter));
+    memcpy(program.data(), compiled.data(), compiled.size());
+    if (!ProgramLogsFailures(program)) {
+        LOG(ERROR) << argv[2] << " does not log failures, compile it with --use-ret-log.";
+        return 1;
+    }
+
+    return WritePrecompiledPolicy(policy, program, argv[3]) ? 0 : 1;
+}
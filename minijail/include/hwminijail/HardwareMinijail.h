@@ -22,8 +22,15 @@
 namespace android {
 namespace hardware {
 
+// Enters a seccomp sandbox built from the policy at seccomp_policy_path. If the program precompiled
+// from it is installed at seccomp_policy_path + ".bpf", it is used instead of parsing the policy.
 void SetupMinijail(const std::string& seccomp_policy_path);
 
+// Same as above, with the precompiled program (see hwminijail_precompile) at seccomp_bpf_path. It
+// is only used if it was compiled from the current contents of the policy, the policy does not
+// @include others, and the program logs failures. Otherwise the policy is parsed as usual.
+void SetupMinijail(const std::string& seccomp_policy_path, const std::string& seccomp_bpf_path);
+
 }  // namespace hardware
 }  // namespace android
 
@@ -23,14 +23,35 @@
 #pragma clang diagnostic pop
 
 #include <android-base/logging.h>
+#include <android-base/threads.h>
+#include <android/hidl/manager/1.1/IServiceManager.h>
 #include <android/hidl/memory/1.0/IMemory.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <hidl/AllocationCounter.h>
+#include <hidl/CallWatchdog.h>
+#include <hidl/ClientAdmission.h>
+#include <hidl/HidlBinderSupport.h>
+#include <hidl/HidlPassthroughSupport.h>
+#include <hidl/HidlTransportUtils.h>
+#include <hidl/LegacySupport.h>
+#include <hidl/ManifestIndex.h>
+#include <hidl/MQDescriptor.h>
+#include <hidl/OnewayCallQueue.h>
+#include <hidl/ResourceAccounting.h>
+#include <hidl/ResponseCache.h>
 #include <hidl/ServiceManagement.h>
+#include <hidl/Static.h>
 #include <hidl/Status.h>
 #include <hidl/TaskRunner.h>
+#include <hidlmemory/SharedPayload.h>
+#include <hidlstream/ChunkedStream.h>
+#include <sys/mman.h>
+#include <atomic>
 #include <condition_variable>
 #include <fstream>
+#include <set>
+#include <thread>
 #include <vector>
 
 #ifdef __ANDROID__
@@ -436,6 +457,1253 @@ TEST_F(LibHidlTest, ArrayTest) {
     EXPECT_ARRAYEQ(ha, array, 3);
 }
 
+TEST_F(LibHidlTest, ComputeParcelSizeTest) {
+    using android::hardware::computeParcelSize;
+    using android::hardware::countEmbeddedObjects;
+    using android::hardware::hidl_handle;
+    using android::hardware::hidl_memory;
+    using android::hardware::hidl_string;
+    using android::hardware::hidl_vec;
+    using android::hardware::Parcel;
+    using android::hardware::ParcelSize;
+    using android::hardware::reserveParcelSize;
+    using android::hardware::writeEmbeddedToParcel;
+
+    hidl_vec<hidl_vec<hidl_string>> vec = {{"foo", "", "a longer string"}, {}, {"bar"}};
+
+    ParcelSize size = computeParcelSize(vec);
+    EXPECT_EQ(1u + 1u + 3u + 4u, size.objectCount);
+    EXPECT_EQ(size.objectCount - 1, countEmbeddedObjects(vec));
+
+    Parcel parcel;
+    EXPECT_EQ(android::OK, reserveParcelSize(&parcel, size));
+    size_t capacity = parcel.dataCapacity();
+
+    // Written the way generated code writes a vec<vec<string>> argument.
+    size_t parentHandle;
+    ASSERT_EQ(android::OK, parcel.writeBuffer(&vec, sizeof(vec), &parentHandle));
+    size_t vecHandle;
+    ASSERT_EQ(android::OK, writeEmbeddedToParcel(vec, &parcel, parentHandle, 0, &vecHandle));
+    for (size_t i = 0; i < vec.size(); ++i) {
+        size_t childHandle;
+        ASSERT_EQ(android::OK, writeEmbeddedToParcel(vec[i], &parcel, vecHandle,
+                                                     i * sizeof(hidl_vec<hidl_string>),
+                                                     &childHandle));
+        for (size_t j = 0; j < vec[i].size(); ++j) {
+            ASSERT_EQ(android::OK, writeEmbeddedToParcel(vec[i][j], &parcel, childHandle,
+                                                         j * sizeof(hidl_string)));
+        }
+    }
+
+    EXPECT_EQ(size.dataSize, parcel.dataSize());
+    EXPECT_EQ(size.objectCount, parcel.objectsCount());
+    EXPECT_EQ(capacity, parcel.dataCapacity());
+
+    native_handle_t* nativeHandle = native_handle_create(0 /* numFds */, 2 /* numInts */);
+    hidl_memory memory("ashmem", hidl_handle(nativeHandle), 4096);
+    Parcel memoryParcel;
+    ASSERT_EQ(android::OK, memoryParcel.writeBuffer(&memory, sizeof(memory), &parentHandle));
+    ASSERT_EQ(android::OK, writeEmbeddedToParcel(memory, &memoryParcel, parentHandle, 0));
+    size = computeParcelSize(memory);
+    EXPECT_EQ(size.dataSize, memoryParcel.dataSize());
+    EXPECT_EQ(size.objectCount, memoryParcel.objectsCount());
+    native_handle_delete(nativeHandle);
+}
+
+TEST_F(LibHidlTest, SharedPayloadTest) {
+    using android::hardware::SharedPayload;
+    using android::hardware::SharedPayloadPool;
+    using android::hardware::SharedPayloadView;
+
+    SharedPayloadPool pool(1024 /* inlineThreshold */);
+
+    SharedPayload small = pool.copyFrom("hello", 6);
+    ASSERT_TRUE(small.valid());
+    EXPECT_FALSE(small.isShared());
+    EXPECT_EQ(6u, small.inlineData().size());
+    EXPECT_FALSE(small.memory().valid());
+
+    SharedPayloadView smallView(small.inlineData(), small.memory());
+    ASSERT_TRUE(smallView.valid());
+    EXPECT_STREQ("hello", reinterpret_cast<const char*>(smallView.data()));
+
+    std::vector<uint8_t> contents(100000);
+    for (size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    const void* address;
+    {
+        SharedPayload large = pool.copyFrom(contents.data(), contents.size());
+        ASSERT_TRUE(large.valid());
+        EXPECT_TRUE(large.isShared());
+        EXPECT_EQ(0u, large.inlineData().size());
+        EXPECT_EQ(contents.size(), large.memory().size());
+        address = large.data();
+
+        SharedPayloadView largeView(large.inlineData(), large.memory());
+        ASSERT_TRUE(largeView.valid());
+        ASSERT_EQ(contents.size(), largeView.size());
+        EXPECT_EQ(0, memcmp(contents.data(), largeView.data(), contents.size()));
+    }
+
+    // the region is back in the pool and reused for a payload of the same size class
+    SharedPayload reused = pool.allocate(contents.size() - 1);
+    ASSERT_TRUE(reused.valid());
+    EXPECT_EQ(address, reused.data());
+
+    // receivers cannot write to the region
+    int fd = reused.memory().handle()->data[0];
+    void* writable = mmap(nullptr, reused.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    EXPECT_EQ(MAP_FAILED, writable);
+    if (writable != MAP_FAILED) munmap(writable, reused.size());
+
+    // nor be made to map past its end, or something other than ashmem
+    hidl_memory oversized("ashmem", reused.memory().handle(), 1 << 30);
+    EXPECT_FALSE(SharedPayloadView(hidl_vec<uint8_t>(), oversized).valid());
+    hidl_memory notAshmem("mmap_fd", reused.memory().handle(), reused.size());
+    EXPECT_FALSE(SharedPayloadView(hidl_vec<uint8_t>(), notAshmem).valid());
+}
+
+TEST_F(LibHidlTest, FlatCopyTest) {
+    using android::hardware::hidl_flat_copy;
+    using android::hardware::hidl_string;
+    using android::hardware::hidl_vec;
+
+    auto inBlock = [](const void* p, const void* block, size_t footprint) {
+        const uint8_t* begin = static_cast<const uint8_t*>(block);
+        const uint8_t* ptr = static_cast<const uint8_t*>(p);
+        return ptr >= begin && ptr < begin + footprint;
+    };
+
+    hidl_vec<hidl_string> strings = {"foo", "", "a somewhat longer string"};
+    hidl_flat_copy<hidl_string> stringsCopy(strings);
+    EXPECT_EQ(strings, stringsCopy.get());
+    EXPECT_EQ(3 * sizeof(hidl_string) + 4 + 1 + 25, stringsCopy.footprint());
+    for (size_t i = 0; i < strings.size(); ++i) {
+        EXPECT_NE(strings[i].c_str(), stringsCopy[i].c_str());
+        EXPECT_TRUE(inBlock(stringsCopy[i].c_str(), stringsCopy.get().data(),
+                            stringsCopy.footprint()));
+    }
+
+    hidl_vec<hidl_vec<int32_t>> vecs = {{1, 2, 3}, {}, {4}};
+    hidl_flat_copy<hidl_vec<int32_t>> vecsCopy(vecs);
+    EXPECT_EQ(vecs, vecsCopy.get());
+    EXPECT_TRUE(inBlock(vecsCopy[0].data(), vecsCopy.get().data(), vecsCopy.footprint()));
+    EXPECT_TRUE(inBlock(vecsCopy[2].data(), vecsCopy.get().data(), vecsCopy.footprint()));
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(vecsCopy[2].data()) % alignof(int32_t));
+
+    // copies are independent, moves keep the block
+    hidl_flat_copy<hidl_vec<int32_t>> copied = vecsCopy;
+    EXPECT_EQ(vecs, copied.get());
+    EXPECT_NE(vecsCopy[0].data(), copied[0].data());
+    const int32_t* data = copied[0].data();
+    hidl_flat_copy<hidl_vec<int32_t>> moved = std::move(copied);
+    EXPECT_EQ(data, moved[0].data());
+    EXPECT_EQ(0u, copied.size());
+    EXPECT_EQ(0u, copied.footprint());
+
+    hidl_flat_copy<hidl_string> empty{hidl_vec<hidl_string>()};
+    EXPECT_EQ(0u, empty.size());
+    EXPECT_EQ(0u, empty.footprint());
+}
+
+TEST_F(LibHidlTest, ManifestIndexTest) {
+    using android::hardware::details::ManifestIndex;
+    using Transport = ManifestIndex::Transport;
+
+    std::vector<ManifestIndex::Entry> entries = {
+            {"android.hidl.manager", 1, 2, "IServiceManager", "default", Transport::HWBINDER},
+            {"android.hidl.memory", 1, 0, "IMapper", "ashmem", Transport::PASSTHROUGH},
+            {"android.hardware.foo", 1, 0, "IFoo", "b", Transport::HWBINDER},
+            {"android.hardware.foo", 1, 1, "IFoo", "a", Transport::HWBINDER},
+            {"android.hardware.foo", 1, 0, "IFoo", "a", Transport::HWBINDER},
+            {"android.hardware.foo", 2, 0, "IFoo", "c", Transport::HWBINDER},
+    };
+
+    std::unique_ptr<ManifestIndex> index =
+            ManifestIndex::fromData(ManifestIndex::build(entries));
+    ASSERT_NE(nullptr, index);
+    EXPECT_EQ(5u, index->size());  // duplicate of foo@1.x::IFoo/a merged
+
+    Transport transport;
+    EXPECT_TRUE(index->getTransport("android.hidl.manager@1.0::IServiceManager", "default",
+                                    &transport));
+    EXPECT_EQ(Transport::HWBINDER, transport);
+    EXPECT_TRUE(index->getTransport("android.hidl.manager@1.2::IServiceManager", "default",
+                                    &transport));
+    EXPECT_TRUE(index->getTransport("android.hidl.memory@1.0::IMapper", "ashmem", &transport));
+    EXPECT_EQ(Transport::PASSTHROUGH, transport);
+
+    // newer minor version, other instance, or other HAL: only hwservicemanager knows
+    EXPECT_FALSE(index->getTransport("android.hidl.manager@1.3::IServiceManager", "default",
+                                     &transport));
+    EXPECT_FALSE(index->getTransport("android.hidl.memory@1.0::IMapper", "other", &transport));
+    EXPECT_FALSE(index->getTransport("android.hardware.bar@1.0::IBar", "default", &transport));
+    EXPECT_FALSE(index->getTransport("not a descriptor", "default", &transport));
+
+    std::vector<std::string> visited;
+    index->forEachEntry([&](const std::string& fqName, const std::string& instance, Transport) {
+        visited.push_back(fqName + "/" + instance);
+    });
+    EXPECT_EQ((std::vector<std::string>{
+                      "android.hardware.foo@1.1::IFoo/a",
+                      "android.hardware.foo@1.0::IFoo/b",
+                      "android.hardware.foo@2.0::IFoo/c",
+                      "android.hidl.manager@1.2::IServiceManager/default",
+                      "android.hidl.memory@1.0::IMapper/ashmem",
+              }),
+              visited);
+
+    std::string data = ManifestIndex::build(entries);
+    EXPECT_EQ(nullptr, ManifestIndex::fromData(data.substr(0, data.size() - 1)));
+    EXPECT_EQ(nullptr, ManifestIndex::fromData("not an index"));
+}
+
+TEST_F(LibHidlTest, ManifestIndexConsistencyTest) {
+    using android::hardware::details::getManifestIndex;
+    using android::hardware::details::ManifestIndex;
+    using android::hidl::manager::V1_0::IServiceManager;
+
+    const ManifestIndex* index = getManifestIndex();
+    if (!kAndroid || index == nullptr) GTEST_SKIP();
+
+    auto sm = android::hardware::defaultServiceManager1_1();
+    ASSERT_NE(nullptr, sm);
+
+    index->forEachEntry([&](const std::string& fqName, const std::string& instance,
+                            ManifestIndex::Transport transport) {
+        IServiceManager::Transport expected = sm->getTransport(fqName, instance);
+        EXPECT_EQ(static_cast<uint8_t>(expected), static_cast<uint8_t>(transport))
+                << fqName << "/" << instance;
+    });
+}
+
+TEST_F(LibHidlTest, AllocationCounterTest) {
+    using android::hardware::hidl_string;
+    using android::hardware::ScopedAllocationCounter;
+
+    // the counter itself (volatile so that the compiler cannot elide the pairs)
+    void* volatile memory;
+    int* volatile object;
+    EXPECT_ALLOCATIONS(1, memory = malloc(16));
+    free(memory);
+    EXPECT_ALLOCATIONS(1, object = new int(0));
+    delete object;
+    EXPECT_ALLOCATIONS(1, object = new int[4]);
+    delete[] object;
+    EXPECT_ALLOCATIONS(1, hidl_string s("copied into a new buffer"));
+
+    size_t innerCount;
+    ScopedAllocationCounter outer;
+    {
+        ScopedAllocationCounter inner;
+        memory = malloc(16);
+        free(memory);
+        innerCount = inner.count();
+    }
+    memory = malloc(16);
+    free(memory);
+    size_t outerCount = outer.count();
+    EXPECT_EQ(1u, innerCount);
+    EXPECT_EQ(2u, outerCount);
+}
+
+// Pins the allocations of operations that latency-sensitive HALs rely on being allocation-free.
+TEST_F(LibHidlTest, AllocationCountTest) {
+    using android::hardware::hidl_string;
+    using android::hardware::hidl_vec;
+    using android::hardware::Return;
+    using android::hardware::details::Task;
+    using android::hardware::details::TaskRunner;
+
+    hidl_string string("a string which owns its buffer");
+    hidl_string movedString;
+    EXPECT_NO_ALLOCATIONS(movedString = std::move(string));
+    EXPECT_NO_ALLOCATIONS(hidl_string constructed(std::move(movedString)));
+
+    hidl_vec<int32_t> vec{1, 2, 3, 4};
+    hidl_vec<int32_t> movedVec;
+    EXPECT_NO_ALLOCATIONS(movedVec = std::move(vec));
+    EXPECT_NO_ALLOCATIONS(hidl_vec<int32_t> constructed(std::move(movedVec)));
+
+    static const char kChars[] = "external";
+    int32_t ints[] = {1, 2, 3};
+    EXPECT_NO_ALLOCATIONS(string.setToExternal(kChars, strlen(kChars)));
+    EXPECT_NO_ALLOCATIONS(vec.setToExternal(ints, 3));
+
+    auto getValue = []() -> Return<int32_t> { return 42; };
+    EXPECT_NO_ALLOCATIONS({
+        Return<int32_t> ret = getValue();
+        EXPECT_TRUE(ret.isOk());
+        EXPECT_EQ(42, static_cast<int32_t>(ret));
+    });
+    EXPECT_NO_ALLOCATIONS({
+        Return<void> ret;
+        EXPECT_TRUE(ret.isOk());
+    });
+
+#ifdef _LIBCPP_VERSION
+    // Once the background thread runs and the queue has grown to its steady-state size, pushing
+    // a callable small enough to be stored inline in a Task reuses the queue's storage. (Only
+    // libc++'s deque keeps its spare block; libstdc++ frees and reallocates one as it cycles.)
+    struct Progress {
+        std::mutex mutex;
+        std::condition_variable condition;
+        size_t done = 0;
+    } progress;
+    Task task = [p = &progress] {
+        std::lock_guard<std::mutex> lock(p->mutex);
+        p->done++;
+        p->condition.notify_one();
+    };
+
+    TaskRunner runner;
+    runner.start(1 /* limit */);
+    for (size_t i = 1; i <= 1024; ++i) {
+        if (i <= 512) {
+            EXPECT_TRUE(runner.push(task));
+        } else {
+            EXPECT_NO_ALLOCATIONS(EXPECT_TRUE(runner.push(task)));
+        }
+        std::unique_lock<std::mutex> lock(progress.mutex);
+        progress.condition.wait(lock, [&] { return progress.done == i; });
+    }
+#endif  // _LIBCPP_VERSION
+}
+
+TEST_F(LibHidlTest, StaticChainTest) {
+    using android::sp;
+    using android::hardware::hidl_array;
+    using android::hardware::hidl_hash_chain;
+    using android::hardware::hidl_interface_chain;
+    using android::hardware::hidl_string;
+    using android::hardware::hidl_vec;
+    using android::hardware::Return;
+    using android::hardware::Void;
+    using android::hardware::details::canCastInterface;
+    using android::hidl::base::V1_0::IBase;
+
+    static constexpr const char* kDescriptor = "android.hidl.chain@1.0::IChain";
+    static const uint8_t kHashes[2][32] = {{1, 2, 3}, {4, 5, 6}};
+
+    struct Chained : public IBase {
+        Return<void> interfaceChain(interfaceChain_cb _hidl_cb) override {
+            static const hidl_interface_chain<2> chain({kDescriptor, IBase::descriptor});
+            _hidl_cb(chain);
+            return Void();
+        }
+        Return<void> getHashChain(getHashChain_cb _hidl_cb) override {
+            static const hidl_hash_chain<2> chain(kHashes);
+            _hidl_cb(chain);
+            return Void();
+        }
+    };
+    sp<IBase> chained = new Chained();
+
+    const char* first = nullptr;
+    EXPECT_TRUE(chained->interfaceChain([&](const hidl_vec<hidl_string>& chain) {
+                           ASSERT_EQ(2u, chain.size());
+                           EXPECT_EQ(kDescriptor, chain[0]);
+                           EXPECT_EQ(IBase::descriptor, chain[1]);
+                           // refers to the descriptor rather than a copy
+                           first = chain[0].c_str();
+                       })
+                        .isOk());
+    EXPECT_EQ(kDescriptor, first);
+
+    EXPECT_TRUE(chained->getHashChain([&](const hidl_vec<hidl_array<uint8_t, 32>>& chain) {
+                           ASSERT_EQ(2u, chain.size());
+                           EXPECT_EQ(hidl_array<uint8_t, 32>(kHashes[0]), chain[0]);
+                           EXPECT_EQ(hidl_array<uint8_t, 32>(kHashes[1]), chain[1]);
+                       })
+                        .isOk());
+
+    // Once the chains exist, casting allocates nothing.
+    EXPECT_NO_ALLOCATIONS(EXPECT_TRUE(canCastInterface(chained.get(), kDescriptor)));
+    EXPECT_NO_ALLOCATIONS(EXPECT_TRUE(canCastInterface(chained.get(), IBase::descriptor)));
+    EXPECT_NO_ALLOCATIONS(EXPECT_FALSE(canCastInterface(chained.get(), "android.hidl.x@1.0::IX")));
+}
+
+TEST_F(LibHidlTest, InternedDescriptorTest) {
+    using android::sp;
+    using android::hardware::BHwBinder;
+    using android::hardware::getOrCreateCachedBinder;
+    using android::hardware::hidl_string;
+    using android::hardware::IBinder;
+    using android::hardware::Return;
+    using android::hardware::Void;
+    using android::hardware::details::gBnMap;
+    using android::hardware::details::getBnConstructorMap;
+    using android::hardware::details::getInternedDescriptor;
+    using android::hidl::base::V1_0::IBase;
+
+    static constexpr const char* kDescriptor = "android.hidl.interned@1.0::IInterned";
+
+    struct Interned : public IBase {
+        Return<void> interfaceDescriptor(interfaceDescriptor_cb _hidl_cb) override {
+            static const hidl_string descriptor(kDescriptor);
+            calls++;
+            _hidl_cb(descriptor);
+            return Void();
+        }
+        size_t calls = 0;
+    };
+    struct InternedBinder : public BHwBinder {
+        explicit InternedBinder(IBase* impl) : mImpl(impl) {}
+        ~InternedBinder() { gBnMap->eraseIfEqual(mImpl.get(), this); }
+        const sp<IBase> mImpl;
+    };
+    getBnConstructorMap().set(kDescriptor, [](void* iface) -> sp<IBinder> {
+        return new InternedBinder(static_cast<IBase*>(iface));
+    });
+    sp<Interned> first = new Interned();
+    sp<Interned> second = new Interned();
+
+    // Without a binder, each call asks the object for its descriptor.
+    const char* descriptor = getInternedDescriptor(first.get());
+    EXPECT_STREQ(kDescriptor, descriptor);
+    EXPECT_EQ(descriptor, getInternedDescriptor(second.get()));
+
+    // With one, the descriptor cached on it is returned without asking.
+    sp<IBinder> binder = getOrCreateCachedBinder(first.get());
+    ASSERT_NE(nullptr, binder.get());
+    size_t calls = first->calls;
+    EXPECT_NO_ALLOCATIONS(EXPECT_EQ(descriptor, getInternedDescriptor(first.get())));
+    EXPECT_EQ(calls, first->calls);
+    binder = nullptr;
+    getBnConstructorMap().erase(kDescriptor);
+
+    struct Plain : public IBase {};
+    sp<IBase> plain = new Plain();
+    EXPECT_STREQ(IBase::descriptor, getInternedDescriptor(plain.get()));
+    EXPECT_STREQ("", getInternedDescriptor(nullptr));
+}
+
+TEST_F(LibHidlTest, PassthroughServiceConfigTest) {
+    using android::hardware::parsePassthroughServiceConfig;
+    using android::hardware::PassthroughServiceEntry;
+
+    std::vector<PassthroughServiceEntry> entries;
+    std::string error;
+    ASSERT_TRUE(parsePassthroughServiceConfig("# comment\n"
+                                              "android.hardware.foo@1.0::IFoo\n"
+                                              "\n"
+                                              "  android.hardware.bar@1.0::IBar  internal  # x\n"
+                                              "android.hardware.baz@1.1::IBaz lazy\n"
+                                              "android.hardware.qux@2.0::IQux\tother\tlazy",
+                                              &entries, &error))
+            << error;
+    ASSERT_EQ(4u, entries.size());
+    EXPECT_EQ("android.hardware.foo@1.0::IFoo", entries[0].interfaceName);
+    EXPECT_EQ("default", entries[0].serviceName);
+    EXPECT_FALSE(entries[0].lazy);
+    EXPECT_EQ("android.hardware.bar@1.0::IBar", entries[1].interfaceName);
+    EXPECT_EQ("internal", entries[1].serviceName);
+    EXPECT_FALSE(entries[1].lazy);
+    EXPECT_EQ("default", entries[2].serviceName);
+    EXPECT_TRUE(entries[2].lazy);
+    EXPECT_EQ("android.hardware.qux@2.0::IQux", entries[3].interfaceName);
+    EXPECT_EQ("other", entries[3].serviceName);
+    EXPECT_TRUE(entries[3].lazy);
+
+    EXPECT_TRUE(parsePassthroughServiceConfig("", &entries, &error));
+    EXPECT_TRUE(entries.empty());
+
+    EXPECT_FALSE(parsePassthroughServiceConfig("IFoo\n", &entries, &error));
+    EXPECT_FALSE(parsePassthroughServiceConfig("a@1.0::IFoo default lazy extra\n", &entries,
+                                               &error));
+    EXPECT_NE(std::string::npos, error.find("line 1")) << error;
+}
+
+TEST_F(LibHidlTest, ResourceAccountingTest) {
+    using android::sp;
+    using android::hardware::GrantorDescriptor;
+    using android::hardware::hidl_handle;
+    using android::hardware::HidlMemory;
+    using android::hardware::MQDescriptorSync;
+    using android::hardware::details::getSharedResourceUsage;
+    using android::hardware::details::setResourceAccountingEnabled;
+    using android::hardware::details::SharedResource;
+
+    // amount of type held, over all sites
+    auto live = [](SharedResource type) {
+        uint64_t amount = 0;
+        for (const auto& usage : getSharedResourceUsage()) {
+            if (usage.type == type) amount += usage.amount;
+        }
+        return amount;
+    };
+    auto makeHandle = [] {
+        native_handle_t* handle = native_handle_create(1 /* numFds */, 0 /* numInts */);
+        handle->data[0] = dup(STDERR_FILENO);
+        return handle;
+    };
+
+    setResourceAccountingEnabled(true);
+
+    uint64_t fds = live(SharedResource::HANDLE);
+    {
+        hidl_handle first;
+        first.setTo(makeHandle(), true /* shouldOwn */);
+        EXPECT_EQ(fds + 1, live(SharedResource::HANDLE));
+        hidl_handle second = first;  // clones
+        EXPECT_EQ(fds + 2, live(SharedResource::HANDLE));
+        hidl_handle third = std::move(second);
+        EXPECT_EQ(fds + 2, live(SharedResource::HANDLE));
+    }
+    EXPECT_EQ(fds, live(SharedResource::HANDLE));
+
+    uint64_t bytes = live(SharedResource::HIDL_MEMORY);
+    {
+        sp<HidlMemory> memory = HidlMemory::getInstance("accounted", dup(STDERR_FILENO), 4096);
+        EXPECT_EQ(bytes + 4096, live(SharedResource::HIDL_MEMORY));
+        bool named = false;
+        for (const auto& usage : getSharedResourceUsage()) {
+            named |= usage.type == SharedResource::HIDL_MEMORY && usage.name == "accounted";
+        }
+        EXPECT_TRUE(named);
+    }
+    EXPECT_EQ(bytes, live(SharedResource::HIDL_MEMORY));
+
+    uint64_t queueFds = live(SharedResource::MQ_DESCRIPTOR);
+    {
+        MQDescriptorSync<uint8_t> first(std::vector<GrantorDescriptor>(), makeHandle(), 1);
+        EXPECT_EQ(queueFds + 1, live(SharedResource::MQ_DESCRIPTOR));
+        MQDescriptorSync<uint8_t> second(first);
+        EXPECT_EQ(queueFds + 2, live(SharedResource::MQ_DESCRIPTOR));
+    }
+    EXPECT_EQ(queueFds, live(SharedResource::MQ_DESCRIPTOR));
+
+    setResourceAccountingEnabled(false);
+
+    // only resources acquired while enabled are counted
+    hidl_handle unaccounted;
+    unaccounted.setTo(makeHandle(), true /* shouldOwn */);
+    EXPECT_EQ(fds, live(SharedResource::HANDLE));
+}
+
+TEST_F(LibHidlTest, ChunkedStreamTest) {
+    using android::hardware::ChunkedStreamReader;
+    using android::hardware::ChunkedStreamWriter;
+
+    static constexpr size_t kChunkSize = 4096;
+    static constexpr int64_t kTimeoutNanos = 5000000000;  // 5s
+
+    auto writer = ChunkedStreamWriter::create(kChunkSize, 4 /* credits */);
+    ASSERT_NE(nullptr, writer.get());
+    auto reader = ChunkedStreamReader::create(*writer->getDesc(), kChunkSize);
+    ASSERT_NE(nullptr, reader.get());
+    EXPECT_EQ(nullptr, ChunkedStreamReader::create(*writer->getDesc(), 1000).get());
+
+    // nothing written yet
+    bool last = false;
+    EXPECT_FALSE(reader->readChunk([](const uint8_t*, size_t) {}, &last, 1000000 /* 1ms */));
+
+    // larger than the queue, so the writer must wait for credits
+    std::vector<uint8_t> payload(kChunkSize * 20 + 123);
+    for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<uint8_t>(i * 7);
+
+    std::thread writing([&] { EXPECT_TRUE(writer->write(payload.data(), payload.size())); });
+    std::vector<uint8_t> received;
+    size_t chunks = 0;
+    EXPECT_TRUE(reader->readAll(
+            [&](const uint8_t* data, size_t size) {
+                EXPECT_LE(size, kChunkSize);
+                received.insert(received.end(), data, data + size);
+                chunks++;
+            },
+            kTimeoutNanos));
+    writing.join();
+    EXPECT_EQ(payload, received);
+    EXPECT_EQ(21u, chunks);
+
+    // an empty payload is a single empty chunk
+    EXPECT_TRUE(writer->write(nullptr, 0));
+    size_t size = 1;
+    EXPECT_TRUE(reader->readChunk([&](const uint8_t*, size_t s) { size = s; }, &last,
+                                  kTimeoutNanos));
+    EXPECT_EQ(0u, size);
+    EXPECT_TRUE(last);
+}
+
+TEST_F(LibHidlTest, OnewayCallQueueTest) {
+    using android::sp;
+    using android::hardware::OnewayCallQueue;
+    using android::hardware::Return;
+    using android::hardware::Status;
+    using android::hardware::Void;
+    using android::hidl::base::V1_0::IBase;
+
+    struct Target : public IBase {};
+    sp<IBase> a = new Target();
+    sp<IBase> b = new Target();
+
+    std::mutex mutex;
+    std::condition_variable called;
+    std::vector<std::string> calls;
+    auto record = [&](const std::string& name) -> OnewayCallQueue::Call {
+        return [&, name] {
+            std::lock_guard<std::mutex> lock(mutex);
+            calls.push_back(name);
+            called.notify_all();
+            return Void();
+        };
+    };
+
+    // only sent when full or flushed
+    OnewayCallQueue::Config config;
+    config.maxCalls = 4;
+    config.maxBytes = 0;
+    config.maxDelay = std::chrono::hours(1);
+    OnewayCallQueue queue(config);
+
+    EXPECT_FALSE(queue.enqueue(a, nullptr));
+    EXPECT_TRUE(queue.enqueue(a, record("a1")));
+    EXPECT_TRUE(queue.enqueue(a, record("update1"), 0, 7 /* coalescingKey */));
+    EXPECT_TRUE(queue.enqueue(b, record("b1"), 0, 7 /* coalescingKey */));
+    EXPECT_TRUE(queue.enqueue(a, record("a2")));
+    EXPECT_TRUE(queue.enqueue(a, record("update2"), 0, 7 /* coalescingKey */));
+    queue.flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> sentToA;
+        std::copy_if(calls.begin(), calls.end(), std::back_inserter(sentToA),
+                     [](const std::string& call) { return call != "b1"; });
+        EXPECT_EQ((std::vector<std::string>{"a1", "a2", "update2"}), sentToA);
+        EXPECT_EQ(4u, calls.size());
+        calls.clear();
+    }
+    OnewayCallQueue::Stats stats = queue.getStats();
+    EXPECT_EQ(5u, stats.queued);
+    EXPECT_EQ(1u, stats.coalesced);
+    EXPECT_EQ(4u, stats.sent);
+    EXPECT_EQ(0u, stats.failed);
+    EXPECT_EQ(2u, stats.batches);
+
+    // a full batch is sent without a flush
+    for (size_t i = 0; i < config.maxCalls; ++i) queue.enqueue(b, record(std::to_string(i)));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(called.wait_for(lock, std::chrono::seconds(5),
+                                    [&] { return calls.size() == config.maxCalls; }));
+        EXPECT_EQ((std::vector<std::string>{"0", "1", "2", "3"}), calls);
+    }
+
+    // calls after one to a dead target are dropped
+    queue.enqueue(a, [] { return Return<void>(Status::fromStatusT(android::DEAD_OBJECT)); });
+    queue.enqueue(a, record("after death"));
+    queue.flush();
+    stats = queue.getStats();
+    EXPECT_EQ(4u, stats.batches);
+    EXPECT_EQ(2u, stats.failed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(4u, calls.size());
+        calls.clear();
+    }
+
+    // flush only waits for the calls queued before it, even if other calls keep being queued
+    std::atomic<bool> producing{true};
+    std::thread producer([&] {
+        while (producing) queue.enqueue(b, [] { return Void(); });
+    });
+    queue.enqueue(a, record("flushed"));
+    queue.flush();
+    producing = false;
+    producer.join();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ((std::vector<std::string>{"flushed"}), calls);
+        calls.clear();
+    }
+
+    // a queued call cannot wait for the queue
+    EXPECT_DEATH(
+            {
+                OnewayCallQueue inner(config);
+                inner.enqueue(a, [&] {
+                    inner.flush();
+                    return Void();
+                });
+                inner.flush();
+            },
+            "wait for itself");
+
+    // a call is sent by itself once it has waited maxDelay
+    config.maxDelay = std::chrono::milliseconds(1);
+    OnewayCallQueue delayed(config);
+    delayed.enqueue(a, record("delayed"));
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_TRUE(called.wait_for(lock, std::chrono::seconds(5), [&] { return !calls.empty(); }));
+}
+
+TEST_F(LibHidlTest, CallWatchdogTest) {
+    using android::hardware::details::HidlInstrumentor;
+    using android::hardware::details::HungCall;
+    using android::hardware::details::isCallWatchdogEnabled;
+    using android::hardware::details::setCallWatchdogTimeout;
+    using android::hardware::details::startCallWatchdog;
+    using android::hardware::details::stopCallWatchdog;
+    using std::chrono::milliseconds;
+
+    struct Instrumented : public HidlInstrumentor {
+        Instrumented() : HidlInstrumentor("android.hardware.tests.hang", "IHang") {}
+
+        void event(InstrumentationEvent event, const char* interface, const char* method) {
+            for (const auto& callback : getInstrumentationCallbacks()) {
+                callback(event, "android.hardware.tests.hang", "1.0", interface, method, nullptr);
+            }
+        }
+    };
+
+    EXPECT_FALSE(isCallWatchdogEnabled());
+    EXPECT_TRUE(Instrumented().getInstrumentationCallbacks().empty());
+
+    std::mutex mutex;
+    std::condition_variable reported;
+    std::vector<HungCall> hung;
+    startCallWatchdog(milliseconds(20), [&](const HungCall& call) {
+        std::lock_guard<std::mutex> lock(mutex);
+        hung.push_back(call);
+        reported.notify_all();
+    });
+    ASSERT_TRUE(isCallWatchdogEnabled());
+    setCallWatchdogTimeout("android.hardware.tests.hang@1.0::ISlow", std::chrono::hours(1));
+
+    Instrumented instrumented;
+    EXPECT_TRUE(instrumented.isInstrumentationEnabled());
+    ASSERT_EQ(1u, instrumented.getInstrumentationCallbacks().size());
+
+    // returns in time
+    instrumented.event(HidlInstrumentor::CLIENT_API_ENTRY, "IHang", "quick");
+    instrumented.event(HidlInstrumentor::CLIENT_API_EXIT, "IHang", "quick");
+
+    // a call which is allowed to be slow, and one which hangs inside it
+    pid_t tid = 0;
+    std::atomic<bool> release{false};
+    std::thread caller([&] {
+        tid = android::base::GetThreadId();
+        instrumented.event(HidlInstrumentor::CLIENT_API_ENTRY, "ISlow", "slow");
+        instrumented.event(HidlInstrumentor::PASSTHROUGH_ENTRY, "IHang", "hang");
+        while (!release) std::this_thread::sleep_for(milliseconds(1));
+        instrumented.event(HidlInstrumentor::PASSTHROUGH_EXIT, "IHang", "hang");
+        instrumented.event(HidlInstrumentor::CLIENT_API_EXIT, "ISlow", "slow");
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(reported.wait_for(lock, std::chrono::seconds(5),
+                                      [&] { return !hung.empty(); }));
+    }
+    // reported once, even though it keeps hanging
+    std::this_thread::sleep_for(milliseconds(100));
+    release = true;
+    caller.join();
+    stopCallWatchdog();
+    EXPECT_FALSE(isCallWatchdogEnabled());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(1u, hung.size());
+    EXPECT_EQ("android.hardware.tests.hang@1.0::IHang::hang", hung[0].descriptor);
+    EXPECT_EQ(HidlInstrumentor::PASSTHROUGH_ENTRY, hung[0].event);
+    EXPECT_EQ(tid, hung[0].tid);
+    EXPECT_GE(hung[0].elapsed, milliseconds(20));
+}
+
+TEST_F(LibHidlTest, CallWatchdogFailedCallTest) {
+    using android::hardware::details::HidlInstrumentor;
+    using android::hardware::details::HungCall;
+    using android::hardware::details::startCallWatchdog;
+    using android::hardware::details::stopCallWatchdog;
+    using std::chrono::milliseconds;
+
+    struct Instrumented : public HidlInstrumentor {
+        Instrumented() : HidlInstrumentor("android.hardware.tests.fail", "IFail") {}
+
+        void event(InstrumentationEvent event, const char* method) {
+            for (const auto& callback : getInstrumentationCallbacks()) {
+                callback(event, "android.hardware.tests.fail", "1.0", "IFail", method, nullptr);
+            }
+        }
+    };
+
+    std::mutex mutex;
+    std::condition_variable reported;
+    std::vector<HungCall> hung;
+    startCallWatchdog(milliseconds(20), [&](const HungCall& call) {
+        std::lock_guard<std::mutex> lock(mutex);
+        hung.push_back(call);
+        reported.notify_all();
+    });
+    Instrumented instrumented;
+
+    std::atomic<bool> release{false};
+    std::thread caller([&] {
+        // Calls which fail, like a proxy whose transaction fails, or a passthrough wrapper whose
+        // implementation does not call its callback, do not report their exit. None of these
+        // are hung.
+        for (int i = 0; i < 20; ++i) {
+            instrumented.event(HidlInstrumentor::CLIENT_API_ENTRY, "failed");
+        }
+        instrumented.event(HidlInstrumentor::PASSTHROUGH_ENTRY, "outer");
+        instrumented.event(HidlInstrumentor::PASSTHROUGH_ENTRY, "noCallback");
+        instrumented.event(HidlInstrumentor::PASSTHROUGH_EXIT, "outer");
+
+        instrumented.event(HidlInstrumentor::SERVER_API_ENTRY, "serve");
+        instrumented.event(HidlInstrumentor::CLIENT_API_ENTRY, "failedInServer");
+        instrumented.event(HidlInstrumentor::CLIENT_API_ENTRY, "failedAgain");
+        instrumented.event(HidlInstrumentor::SERVER_API_EXIT, "serve");
+        instrumented.event(HidlInstrumentor::SERVER_API_ENTRY, "noExit");
+        instrumented.event(HidlInstrumentor::SERVER_API_ENTRY, "next");
+        instrumented.event(HidlInstrumentor::SERVER_API_EXIT, "next");
+
+        instrumented.event(HidlInstrumentor::CLIENT_API_ENTRY, "failedBeforeJoining");
+        android::hardware::details::resetCallWatchdogThread();
+
+        // an exit without an entry, and calls nested deeper than are tracked
+        instrumented.event(HidlInstrumentor::CLIENT_API_EXIT, "unknown");
+        for (int i = 0; i < 20; ++i) {
+            instrumented.event(HidlInstrumentor::PASSTHROUGH_ENTRY, "deep");
+        }
+        for (int i = 0; i < 20; ++i) {
+            instrumented.event(HidlInstrumentor::PASSTHROUGH_EXIT, "deep");
+        }
+
+        // and a call which hangs later is still reported
+        instrumented.event(HidlInstrumentor::CLIENT_API_ENTRY, "hang");
+        while (!release) std::this_thread::sleep_for(milliseconds(1));
+        instrumented.event(HidlInstrumentor::CLIENT_API_EXIT, "hang");
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(reported.wait_for(lock, std::chrono::seconds(5),
+                                      [&] { return !hung.empty(); }));
+    }
+    std::this_thread::sleep_for(milliseconds(100));
+    release = true;
+    caller.join();
+    stopCallWatchdog();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(1u, hung.size());
+    EXPECT_EQ("android.hardware.tests.fail@1.0::IFail::hang", hung[0].descriptor);
+    EXPECT_EQ(HidlInstrumentor::CLIENT_API_ENTRY, hung[0].event);
+}
+
+TEST_F(LibHidlTest, ClientAdmissionTest) {
+    using android::hardware::ClientAdmission;
+    using Client = ClientAdmission::Client;
+
+    ClientAdmission::Policy policy;
+    policy.maxConcurrent = 2;
+    ClientAdmission admission(policy);
+
+    // concurrency limit, refusing calls over it
+    Client busy{100, 1000};
+    ClientAdmission::Ticket first = admission.admit(busy);
+    ClientAdmission::Ticket second = admission.admit(busy);
+    EXPECT_TRUE(first);
+    EXPECT_TRUE(second);
+    EXPECT_FALSE(admission.admit(busy));
+    EXPECT_TRUE(admission.admit(Client{101, 1000}));  // another client
+    first = ClientAdmission::Ticket();
+    EXPECT_TRUE(admission.admit(busy));
+
+    // rate limit for one uid
+    ClientAdmission::Policy limited;
+    limited.ratePerSecond = 1;
+    limited.burst = 2;
+    admission.setPolicy(2000, limited);
+    Client chatty{200, 2000};
+    EXPECT_TRUE(admission.admit(chatty));
+    EXPECT_TRUE(admission.admit(chatty));
+    EXPECT_FALSE(admission.admit(chatty));
+
+    // a queued call is admitted once another returns
+    ClientAdmission::Policy queueing;
+    queueing.maxConcurrent = 1;
+    queueing.maxQueued = 1;
+    queueing.maxQueueDelay = std::chrono::seconds(5);
+    admission.setPolicy(3000, queueing);
+    Client patient{300, 3000};
+    ClientAdmission::Ticket running = admission.admit(patient);
+    ASSERT_TRUE(running);
+    std::thread waiting([&] { EXPECT_TRUE(admission.admit(patient)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    running = ClientAdmission::Ticket();
+    waiting.join();
+
+    for (const ClientAdmission::ClientStats& stats : admission.getStats()) {
+        if (stats.client.pid == busy.pid) {
+            EXPECT_EQ(3u, stats.admitted);
+            EXPECT_EQ(1u, stats.rejected);
+            EXPECT_EQ(1u, stats.inFlight);  // second
+            EXPECT_EQ(2u, stats.peakInFlight);
+        } else if (stats.client.pid == chatty.pid) {
+            EXPECT_EQ(2u, stats.admitted);
+            EXPECT_EQ(1u, stats.rejected);
+        } else if (stats.client.pid == patient.pid) {
+            EXPECT_EQ(2u, stats.admitted);
+            EXPECT_EQ(1u, stats.queued);
+            EXPECT_EQ(0u, stats.rejected);
+            EXPECT_GT(stats.queueTime.count(), 0);
+        }
+    }
+}
+
+TEST_F(LibHidlTest, ClientAdmissionLoadTest) {
+    using android::hardware::ClientAdmission;
+    using Client = ClientAdmission::Client;
+
+    // Like a server with 8 binder threads: an abusive client makes calls from all of them, while
+    // a well-behaved one makes a call at a time.
+    static constexpr size_t kThreads = 8;
+    static constexpr size_t kCalls = 50;
+    ClientAdmission::Policy policy;
+    policy.maxConcurrent = 2;
+    policy.maxQueued = 2;
+    policy.maxQueueDelay = std::chrono::milliseconds(1);
+    ClientAdmission admission(policy);
+
+    Client abusive{100, 1000};
+    Client polite{200, 2000};
+    std::atomic<size_t> running{0};
+    std::atomic<size_t> peak{0};
+    std::atomic<size_t> politeAdmitted{0};
+
+    auto call = [&](const Client& client) {
+        ClientAdmission::Ticket ticket = admission.admit(client);
+        if (!ticket) return false;
+        if (client.pid == abusive.pid) {
+            size_t now = ++running;
+            size_t seen = peak;
+            while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        if (client.pid == abusive.pid) running--;
+        return true;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&] {
+            for (size_t j = 0; j < kCalls; ++j) call(abusive);
+        });
+    }
+    threads.emplace_back([&] {
+        for (size_t j = 0; j < kCalls; ++j) politeAdmitted += call(polite);
+    });
+    for (std::thread& thread : threads) thread.join();
+
+    EXPECT_LE(peak, policy.maxConcurrent);
+    EXPECT_EQ(kCalls, politeAdmitted);
+    for (const ClientAdmission::ClientStats& stats : admission.getStats()) {
+        EXPECT_EQ(0u, stats.inFlight);
+        EXPECT_LE(stats.peakInFlight, policy.maxConcurrent);
+        if (stats.client.pid == abusive.pid) {
+            EXPECT_EQ(kThreads * kCalls, stats.admitted + stats.rejected);
+            EXPECT_GT(stats.rejected, 0u);
+        }
+    }
+}
+
+TEST_F(LibHidlTest, ResponseCacheTest) {
+    using android::sp;
+    using android::hardware::hidl_vec;
+    using android::hardware::ResponseCache;
+    using android::hardware::Return;
+    using android::hardware::Status;
+    using android::hardware::Void;
+    using android::hidl::base::V1_0::IBase;
+
+    struct Counted : public IBase {
+        Return<void> interfaceChain(interfaceChain_cb _hidl_cb) override {
+            chainCalls++;
+            _hidl_cb({IBase::descriptor});
+            return Void();
+        }
+        size_t chainCalls = 0;
+    };
+    sp<Counted> service = new Counted();
+    sp<ResponseCache> cache = ResponseCache::create(service);
+
+    for (size_t i = 0; i < 3; ++i) {
+        hidl_vec<hidl_string> chain;
+        EXPECT_TRUE(cache->interfaceChain([&](const auto& c) { chain = c; }).isOk());
+        ASSERT_EQ(1u, chain.size());
+        EXPECT_EQ(IBase::descriptor, chain[0]);
+    }
+    EXPECT_EQ(1u, service->chainCalls);
+
+    size_t fetches = 0;
+    auto getVersion = [&] {
+        return cache->get<uint32_t>("getVersion", [&]() -> Return<uint32_t> {
+            fetches++;
+            return 7u;
+        });
+    };
+    EXPECT_EQ(7u, static_cast<uint32_t>(getVersion()));
+    EXPECT_EQ(7u, static_cast<uint32_t>(getVersion()));
+    EXPECT_EQ(1u, fetches);
+    cache->invalidate("getVersion");
+    EXPECT_EQ(7u, static_cast<uint32_t>(getVersion()));
+    EXPECT_EQ(2u, fetches);
+
+    // expiry, setting which drops the cached response
+    cache->setTtl("getVersion", std::chrono::milliseconds(1));
+    EXPECT_TRUE(getVersion().isOk());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(getVersion().isOk());
+    EXPECT_EQ(4u, fetches);
+
+    // errors are not cached
+    size_t failures = 0;
+    auto failing = [&] {
+        return cache->get<uint32_t>("getFailing", [&]() -> Return<uint32_t> {
+            failures++;
+            return Status::fromExceptionCode(Status::EX_TRANSACTION_FAILED);
+        });
+    };
+    EXPECT_FALSE(failing().isOk());
+    EXPECT_FALSE(failing().isOk());
+    EXPECT_EQ(2u, failures);
+
+    // death forgets everything
+    cache->serviceDied(0 /* cookie */, android::wp<IBase>());
+    EXPECT_TRUE(cache->interfaceChain([](const auto&) {}).isOk());
+    EXPECT_EQ(2u, service->chainCalls);
+
+    for (const ResponseCache::MethodStats& stats : cache->getStats()) {
+        if (stats.method == "interfaceChain") {
+            EXPECT_EQ(2u, stats.hits);
+            EXPECT_EQ(2u, stats.misses);
+            EXPECT_EQ(1u, stats.invalidations);
+            EXPECT_DOUBLE_EQ(0.5, stats.hitRate());
+        } else if (stats.method == "getVersion") {
+            EXPECT_EQ(1u, stats.hits);
+            EXPECT_EQ(4u, stats.misses);
+        } else if (stats.method == "getFailing") {
+            EXPECT_EQ(0u, stats.hits);
+            EXPECT_EQ(2u, stats.misses);
+        }
+    }
+
+    // caches of a remote service are linked to its death until closed, and stop caching then
+    struct Remote : public Counted {
+        bool isRemote() const override { return true; }
+        Return<bool> linkToDeath(const sp<android::hardware::hidl_death_recipient>&,
+                                 uint64_t) override {
+            links++;
+            return true;
+        }
+        Return<bool> unlinkToDeath(const sp<android::hardware::hidl_death_recipient>&) override {
+            links--;
+            return true;
+        }
+        size_t links = 0;
+    };
+    sp<Remote> remote = new Remote();
+    for (size_t i = 0; i < 3; ++i) {
+        sp<ResponseCache> remoteCache = ResponseCache::create(remote);
+        EXPECT_EQ(1u, remote->links);
+        EXPECT_TRUE(remoteCache->interfaceChain([](const auto&) {}).isOk());
+        remoteCache->close();
+        remoteCache->close();
+        EXPECT_EQ(0u, remote->links);
+        EXPECT_TRUE(remoteCache->interfaceChain([](const auto&) {}).isOk());
+    }
+    EXPECT_EQ(6u, remote->chainCalls);
+}
+
+TEST_F(LibHidlTest, WrapPassthroughTest) {
+    using android::sp;
+    using android::hardware::hidl_interface_chain;
+    using android::hardware::Return;
+    using android::hardware::Void;
+    using android::hardware::details::getBsConstructorMap;
+    using android::hardware::details::wrapPassthroughInternal;
+    using android::hidl::base::V1_0::IBase;
+
+    static constexpr const char* kExtension = "android.hidl.wrap@1.1::IWrap";
+    static constexpr const char* kWrapped = "android.hidl.wrap@1.0::IWrap";
+
+    // extends kWrapped, but only that has a Bs constructor, as if kExtension's library was not
+    // loaded in this linker namespace
+    struct Extension : public IBase {
+        Return<void> interfaceChain(interfaceChain_cb _hidl_cb) override {
+            static const hidl_interface_chain<3> chain({kExtension, kWrapped, IBase::descriptor});
+            _hidl_cb(chain);
+            return Void();
+        }
+    };
+    struct Wrapper : public IBase {
+        explicit Wrapper(IBase* impl) : mImpl(impl) {}
+        const sp<IBase> mImpl;
+    };
+    auto registerWrapper = [] {
+        getBsConstructorMap().set(kWrapped, [](void* iface) -> sp<IBase> {
+            return new Wrapper(static_cast<IBase*>(iface));
+        });
+    };
+
+    struct ExtensionWrapper : public Wrapper {
+        using Wrapper::Wrapper;
+    };
+
+    registerWrapper();
+    for (int i = 0; i < 3; ++i) {
+        sp<IBase> extension = new Extension();
+        sp<IBase> wrapped = wrapPassthroughInternal(extension);
+        ASSERT_NE(nullptr, wrapped.get());
+        EXPECT_EQ(extension.get(), static_cast<Wrapper*>(wrapped.get())->mImpl.get());
+    }
+
+    // As when the interface library is unloaded: this falls back to IBase's wrapper,
+    getBsConstructorMap().erase(kWrapped);
+    wrapPassthroughInternal(new Extension());
+
+    // but not once it is loaded again,
+    registerWrapper();
+    sp<IBase> extension = new Extension();
+    sp<IBase> wrapped = wrapPassthroughInternal(extension);
+    ASSERT_NE(nullptr, wrapped.get());
+    EXPECT_EQ(extension.get(), static_cast<Wrapper*>(wrapped.get())->mImpl.get());
+
+    // and a constructor for the extension itself, e.x. registered later by its own library, is
+    // preferred over its parent's.
+    bool extensionWrapped = false;
+    getBsConstructorMap().set(kExtension, [&](void* iface) -> sp<IBase> {
+        extensionWrapped = true;
+        return new ExtensionWrapper(static_cast<IBase*>(iface));
+    });
+    extension = new Extension();
+    wrapped = wrapPassthroughInternal(extension);
+    ASSERT_NE(nullptr, wrapped.get());
+    EXPECT_TRUE(extensionWrapped);
+    EXPECT_EQ(extension.get(), static_cast<Wrapper*>(wrapped.get())->mImpl.get());
+
+    // A constructor which fails falls back to the parent's.
+    getBsConstructorMap().set(kExtension, [](void*) -> sp<IBase> { return nullptr; });
+    extension = new Extension();
+    wrapped = wrapPassthroughInternal(extension);
+    ASSERT_NE(nullptr, wrapped.get());
+    EXPECT_EQ(extension.get(), static_cast<Wrapper*>(wrapped.get())->mImpl.get());
+
+    getBsConstructorMap().erase(kExtension);
+    getBsConstructorMap().erase(kWrapped);
+}
+
+TEST_F(LibHidlTest, StringListTest) {
+    using android::hardware::computeParcelSize;
+    using android::hardware::hidl_string;
+    using android::hardware::hidl_string_list;
+    using android::hardware::hidl_vec;
+    using android::hardware::Parcel;
+    using android::hardware::readEmbeddedFromParcel;
+    using android::hardware::writeEmbeddedToParcel;
+
+    hidl_string_list empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_TRUE(empty.isValid());
+
+    hidl_vec<hidl_string> strings = {"android.hidl.base@1.0::IBase", "", "foo"};
+    hidl_string_list list(strings);
+    ASSERT_EQ(3u, list.size());
+    EXPECT_TRUE(list.isValid());
+    EXPECT_EQ(strings, list.views());
+    EXPECT_EQ(0u, list[1].size());
+    EXPECT_EQ(list, hidl_string_list({"android.hidl.base@1.0::IBase", "", "foo"}));
+    EXPECT_EQ((std::vector<std::string>{"android.hidl.base@1.0::IBase", "", "foo"}),
+              static_cast<std::vector<std::string>>(list));
+
+    // views point into the list
+    hidl_string view = list[2];
+    EXPECT_EQ(list.chars().data() + list.offsets()[2], view.c_str());
+
+    Parcel parcel;
+    size_t parentHandle;
+    ASSERT_EQ(android::OK, parcel.writeBuffer(&list, sizeof(list), &parentHandle));
+    ASSERT_EQ(android::OK, writeEmbeddedToParcel(list, &parcel, parentHandle, 0));
+    EXPECT_EQ(computeParcelSize(list).objectCount, parcel.objectsCount());
+    EXPECT_EQ(3u, parcel.objectsCount());
+
+    parcel.setDataPosition(0);
+    const hidl_string_list* received;
+    ASSERT_EQ(android::OK, parcel.readBuffer(sizeof(*received), &parentHandle,
+                                             reinterpret_cast<const void**>(&received)));
+    ASSERT_EQ(android::OK, readEmbeddedFromParcel(*received, parcel, parentHandle, 0));
+    EXPECT_EQ(list, *received);
+}
+
+TEST_F(LibHidlTest, StringValidationTest) {
+    using android::hardware::hidl_string;
+    using android::hardware::hidl_string_requirements;
+    using android::hardware::hidl_string_validation;
+    using android::hardware::Parcel;
+    using android::hardware::readEmbeddedFromParcel;
+    using android::hardware::validateHidlString;
+    using android::hardware::writeEmbeddedToParcel;
+
+    auto validate = [](const std::string& s) { return validateHidlString(s.data(), s.size()); };
+
+    hidl_string_validation ascii = validate("android.hardware.tests.foo@1.0::IFoo/default");
+    EXPECT_TRUE(ascii.isAscii);
+    EXPECT_FALSE(ascii.hasEmbeddedNul);
+    EXPECT_TRUE(ascii.isUtf8);
+
+    // longer than one block, with the interesting byte in the second block
+    hidl_string_validation nul = validate(std::string("0123456789abcdefgh\0ij", 22));
+    EXPECT_TRUE(nul.isAscii);
+    EXPECT_TRUE(nul.hasEmbeddedNul);
+    EXPECT_TRUE(nul.isUtf8);
+
+    hidl_string_validation utf8 = validate("caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 0123456789");
+    EXPECT_FALSE(utf8.isAscii);
+    EXPECT_FALSE(utf8.hasEmbeddedNul);
+    EXPECT_TRUE(utf8.isUtf8);
+
+    EXPECT_FALSE(validate("\xc0\x80").isUtf8);          // overlong NUL
+    EXPECT_FALSE(validate("\xed\xa0\x80").isUtf8);      // surrogate
+    EXPECT_FALSE(validate("\xf4\x90\x80\x80").isUtf8);  // above U+10FFFF
+    EXPECT_FALSE(validate("0123456789abcde\xe2\x82").isUtf8);  // truncated
+    EXPECT_FALSE(validate("\x80").isUtf8);
+
+    auto readBack = [](const hidl_string& string, const hidl_string_requirements& requirements,
+                       hidl_string_validation* validation) {
+        Parcel parcel;
+        size_t parentHandle;
+        EXPECT_EQ(android::OK, parcel.writeBuffer(&string, sizeof(string), &parentHandle));
+        EXPECT_EQ(android::OK, writeEmbeddedToParcel(string, &parcel, parentHandle, 0));
+
+        parcel.setDataPosition(0);
+        const hidl_string* received;
+        EXPECT_EQ(android::OK, parcel.readBuffer(sizeof(*received), &parentHandle,
+                                                 reinterpret_cast<const void**>(&received)));
+        return readEmbeddedFromParcel(*received, parcel, parentHandle, 0, requirements,
+                                      validation);
+    };
+
+    hidl_string_requirements requirements;
+    hidl_string_validation validation;
+    EXPECT_EQ(android::OK, readBack("caf\xc3\xa9", requirements, &validation));
+    EXPECT_FALSE(validation.isAscii);
+    EXPECT_EQ(android::BAD_VALUE, readBack(hidl_string("a\0b", 3), requirements, nullptr));
+    EXPECT_EQ(android::BAD_VALUE, readBack("\xff", requirements, nullptr));
+
+    requirements.maxSize = 2;
+    EXPECT_EQ(android::BAD_VALUE, readBack("abc", requirements, nullptr));
+
+    requirements = {};
+    requirements.noEmbeddedNul = false;
+    requirements.utf8 = false;
+    EXPECT_EQ(android::OK, readBack(hidl_string("a\0\xff", 3), requirements, &validation));
+    EXPECT_TRUE(validation.hasEmbeddedNul);
+    EXPECT_FALSE(validation.isUtf8);
+}
+
 TEST_F(LibHidlTest, TaskRunnerTest) {
     using android::hardware::details::TaskRunner;
     using namespace std::chrono_literals;
@@ -458,6 +1726,206 @@ TEST_F(LibHidlTest, TaskRunnerTest) {
     EXPECT_TRUE(flag);
 }
 
+// The following stress the transport's shared state from many threads, checking invariants
+// which a rewrite of its locking (e.x. to be lock-free) must keep.
+static constexpr size_t kStressThreads = 8;
+
+template <typename F>
+static void runOnThreads(size_t count, F f) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < count; ++i) {
+        threads.emplace_back(f, i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+TEST_F(LibHidlTest, ConcurrentMapStressTest) {
+    using android::hardware::ConcurrentMap;
+
+    // every value is its key times 10, so a torn read would show up
+    static constexpr size_t kKeys = 16;
+    ConcurrentMap<size_t, size_t> map;
+    std::atomic<size_t> badReads{0};
+
+    runOnThreads(kStressThreads, [&](size_t thread) {
+        for (size_t i = 0; i < 10000; ++i) {
+            size_t key = (thread + i) % kKeys;
+            switch (i % 4) {
+                case 0:
+                    map.set(size_t(key), key * 10);
+                    break;
+                case 1:
+                    map.eraseIfEqual(key, key * 10);
+                    break;
+                case 2: {
+                    std::unique_lock<std::mutex> lock = map.lock();
+                    for (const auto& [k, v] : map) {
+                        if (v != k * 10) badReads++;
+                    }
+                    break;
+                }
+                default: {
+                    // not get(), whose result refers into the map after it is unlocked
+                    std::unique_lock<std::mutex> lock = map.lock();
+                    if (map.getLocked(key, key * 10) != key * 10) badReads++;
+                }
+            }
+        }
+    });
+
+    EXPECT_EQ(0u, badReads.load());
+    std::unique_lock<std::mutex> lock = map.lock();
+    for (const auto& [k, v] : map) {
+        EXPECT_LT(k, kKeys);
+        EXPECT_EQ(k * 10, v);
+    }
+}
+
+namespace {
+
+constexpr const char* kStressDescriptor = "android.hidl.stress@1.0::IStress";
+
+struct StressBase : public android::hidl::base::V1_0::IBase {
+    android::hardware::Return<void> interfaceDescriptor(interfaceDescriptor_cb _hidl_cb) override {
+        _hidl_cb(kStressDescriptor);
+        return android::hardware::Void();
+    }
+};
+
+// Like a generated BnHw class: holds the implementation and drops its gBnMap entry when destroyed.
+struct StressBinder : public android::hardware::BHwBinder {
+    explicit StressBinder(android::hidl::base::V1_0::IBase* impl) : mImpl(impl) {}
+    ~StressBinder() { android::hardware::details::gBnMap->eraseIfEqual(mImpl.get(), this); }
+
+    const android::sp<android::hidl::base::V1_0::IBase> mImpl;
+};
+
+}  // namespace
+
+TEST_F(LibHidlTest, CachedBinderStressTest) {
+    using android::sp;
+    using android::hardware::getOrCreateCachedBinder;
+    using android::hardware::IBinder;
+    using android::hardware::details::gBnMap;
+    using android::hardware::details::getBnConstructorMap;
+    using android::hidl::base::V1_0::IBase;
+
+    std::atomic<size_t> constructed{0};
+    getBnConstructorMap().set(kStressDescriptor, [&](void* iface) -> sp<IBinder> {
+        constructed++;
+        return new StressBinder(static_cast<IBase*>(iface));
+    });
+
+    // While a binder is alive, every thread gets that same binder.
+    sp<IBase> base = new StressBase();
+    sp<IBinder> anchor = getOrCreateCachedBinder(base.get());
+    ASSERT_NE(nullptr, anchor.get());
+    std::atomic<size_t> mismatches{0};
+    runOnThreads(kStressThreads, [&](size_t) {
+        for (size_t i = 0; i < 10000; ++i) {
+            if (getOrCreateCachedBinder(base.get()) != anchor) mismatches++;
+        }
+    });
+    EXPECT_EQ(0u, mismatches.load());
+    EXPECT_EQ(1u, constructed.load());
+    anchor = nullptr;
+
+    // Otherwise, threads race to promote, construct and destroy it.
+    runOnThreads(kStressThreads, [&](size_t) {
+        for (size_t i = 0; i < 10000; ++i) {
+            sp<IBinder> binder = getOrCreateCachedBinder(base.get());
+            if (binder == nullptr || static_cast<StressBinder*>(binder.get())->mImpl != base) {
+                mismatches++;
+            }
+        }
+    });
+    EXPECT_EQ(0u, mismatches.load());
+
+    // and the last binder destroyed removes the entry.
+    std::unique_lock<std::mutex> lock = gBnMap->lock();
+    EXPECT_EQ(nullptr, gBnMap->getLocked(base.get(), nullptr).promote().get());
+    EXPECT_EQ(0u, gBnMap->eraseLocked(base.get()));
+    lock.unlock();
+
+    getBnConstructorMap().erase(kStressDescriptor);
+}
+
+TEST_F(LibHidlTest, TaskRunnerStressTest) {
+    using android::hardware::details::TaskRunner;
+    using namespace std::chrono_literals;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    size_t accepted = 0;
+    size_t done = 0;
+    std::set<pid_t> workers;
+    auto task = [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        done++;
+        workers.insert(android::base::GetThreadId());
+        condition.notify_all();
+    };
+    auto waitForTasks = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        return condition.wait_for(lock, 10s, [&] { return done == accepted; });
+    };
+
+    // Many threads push into one runner, which is then destroyed with tasks still queued. Its
+    // destructor queues a task to stop the worker thread, which needs room in the queue.
+    {
+        static constexpr size_t kLimit = 64;
+        TaskRunner runner;
+        runner.start(kLimit);
+        std::atomic<size_t> pushed{0};
+        runOnThreads(kStressThreads, [&](size_t) {
+            for (size_t i = 0; i < 1000; ++i) {
+                if (runner.push(task)) pushed++;
+            }
+        });
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted += pushed;
+        }
+        ASSERT_TRUE(waitForTasks());
+        for (size_t i = 0; i < kLimit - 1; ++i) ASSERT_TRUE(runner.push(task));
+        std::lock_guard<std::mutex> lock(mutex);
+        accepted += kLimit - 1;
+    }
+
+    // Each thread starts, pushes into and destroys its own runners.
+    runOnThreads(kStressThreads, [&](size_t) {
+        for (size_t i = 0; i < 100; ++i) {
+            TaskRunner runner;
+            runner.start(4 /* limit */);
+            size_t pushed = 0;
+            for (size_t j = 0; j < 3; ++j) {
+                if (runner.push(task)) pushed++;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted += pushed;
+        }
+    });
+
+    // Every accepted task runs, even after its runner is gone,
+    EXPECT_GT(accepted, 0u);
+    EXPECT_TRUE(waitForTasks());
+
+    // and then every worker thread exits.
+    std::unique_lock<std::mutex> lock(mutex);
+    EXPECT_EQ(accepted, done);
+    auto exists = [](pid_t tid) {
+        return std::ifstream("/proc/self/task/" + std::to_string(tid) + "/stat").good();
+    };
+    for (auto deadline = std::chrono::steady_clock::now() + 10s;
+         std::chrono::steady_clock::now() < deadline;) {
+        if (std::none_of(workers.begin(), workers.end(), exists)) break;
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_TRUE(std::none_of(workers.begin(), workers.end(), exists));
+}
+
 TEST_F(LibHidlTest, StringCmpTest) {
     using android::hardware::hidl_string;
     const char * s = "good";
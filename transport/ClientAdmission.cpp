@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HidlClientAdmission"
+
+#include <hidl/ClientAdmission.h>
+
+#include <algorithm>
+
+#include <hwbinder/IPCThreadState.h>
+
+namespace android {
+namespace hardware {
+
+// Clients which have no calls in flight are forgotten past this many, oldest first, since a
+// server does not learn when its clients exit.
+static constexpr size_t kMaxClients = 256;
+
+void ClientAdmission::ClientState::refill(Clock::time_point now) {
+    if (policy.ratePerSecond <= 0) return;
+    std::chrono::duration<double> elapsed = now - refilled;
+    tokens = std::min(static_cast<double>(policy.burst),
+                      tokens + elapsed.count() * policy.ratePerSecond);
+    refilled = now;
+}
+
+bool ClientAdmission::ClientState::canAdmit() const {
+    return (policy.maxConcurrent == 0 || stats.inFlight < policy.maxConcurrent) &&
+           (policy.ratePerSecond <= 0 || tokens >= 1);
+}
+
+void ClientAdmission::ClientState::admit() {
+    if (policy.ratePerSecond > 0) tokens -= 1;
+    stats.admitted++;
+    stats.inFlight++;
+    stats.peakInFlight = std::max(stats.peakInFlight, stats.inFlight);
+}
+
+ClientAdmission::Clock::time_point ClientAdmission::ClientState::nextToken() const {
+    if (policy.ratePerSecond <= 0 || tokens >= 1) return Clock::time_point::max();
+    std::chrono::duration<double> wait((1 - tokens) / policy.ratePerSecond);
+    return refilled + std::chrono::duration_cast<Clock::duration>(wait);
+}
+
+ClientAdmission::Ticket::Ticket(ClientAdmission* admission, ClientState* state)
+    : mAdmission(admission), mState(state) {}
+
+ClientAdmission::Ticket::Ticket(Ticket&& other)
+    : mAdmission(other.mAdmission), mState(other.mState) {
+    other.mAdmission = nullptr;
+    other.mState = nullptr;
+}
+
+ClientAdmission::Ticket& ClientAdmission::Ticket::operator=(Ticket&& other) {
+    if (this != &other) {
+        release();
+        std::swap(mAdmission, other.mAdmission);
+        std::swap(mState, other.mState);
+    }
+    return *this;
+}
+
+ClientAdmission::Ticket::~Ticket() {
+    release();
+}
+
+void ClientAdmission::Ticket::release() {
+    if (mAdmission == nullptr) return;
+    mAdmission->release(mState);
+    mAdmission = nullptr;
+    mState = nullptr;
+}
+
+ClientAdmission::ClientAdmission(const Policy& policy) : mDefaultPolicy(policy) {}
+
+void ClientAdmission::setPolicy(uid_t uid, const Policy& policy) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPolicies[uid] = policy;
+    for (auto& [client, state] : mClients) {
+        if (client.uid == uid) state.policy = policy;
+    }
+    mReleased.notify_all();
+}
+
+const ClientAdmission::Policy& ClientAdmission::policyLocked(uid_t uid) const {
+    auto it = mPolicies.find(uid);
+    return it == mPolicies.end() ? mDefaultPolicy : it->second;
+}
+
+ClientAdmission::ClientState& ClientAdmission::stateLocked(const Client& client,
+                                                           Clock::time_point now) {
+    auto it = mClients.find(client);
+    if (it == mClients.end()) {
+        if (mClients.size() >= kMaxClients) {
+            auto idle = mClients.end();
+            for (auto c = mClients.begin(); c != mClients.end(); ++c) {
+                const ClientState& state = c->second;
+                if (state.stats.inFlight > 0 || state.waiting > 0) continue;
+                if (idle == mClients.end() || state.lastSeen < idle->second.lastSeen) idle = c;
+            }
+            if (idle != mClients.end()) mClients.erase(idle);
+        }
+
+        it = mClients.emplace(client, ClientState{}).first;
+        ClientState& state = it->second;
+        state.policy = policyLocked(client.uid);
+        state.stats.client = client;
+        state.tokens = static_cast<double>(state.policy.burst);
+        state.refilled = now;
+    }
+    it->second.lastSeen = now;
+    return it->second;
+}
+
+ClientAdmission::Ticket ClientAdmission::admit() {
+    IPCThreadState* self = IPCThreadState::self();
+    return admit(Client{self->getCallingPid(), self->getCallingUid()});
+}
+
+ClientAdmission::Ticket ClientAdmission::admit(const Client& client) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    Clock::time_point now = Clock::now();
+    ClientState& state = stateLocked(client, now);
+    state.refill(now);
+
+    // Calls already waiting go first.
+    if (state.waiting == 0 && state.canAdmit()) {
+        state.admit();
+        return Ticket(this, &state);
+    }
+    if (state.waiting >= state.policy.maxQueued) {
+        state.stats.rejected++;
+        return Ticket();
+    }
+
+    Clock::time_point queuedAt = now;
+    Clock::time_point deadline = now + state.policy.maxQueueDelay;
+    state.waiting++;
+    state.stats.queued++;
+    while (true) {
+        mReleased.wait_until(lock, std::min(deadline, state.nextToken()));
+        now = Clock::now();
+        state.refill(now);
+        bool admitted = state.canAdmit();
+        if (admitted || now >= deadline) {
+            state.waiting--;
+            state.stats.queueTime += now - queuedAt;
+            if (!admitted) {
+                state.stats.rejected++;
+                return Ticket();
+            }
+            state.admit();
+            return Ticket(this, &state);
+        }
+    }
+}
+
+void ClientAdmission::release(ClientState* state) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        state->stats.inFlight--;
+    }
+    mReleased.notify_all();
+}
+
+std::vector<ClientAdmission::ClientStats> ClientAdmission::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<ClientStats> stats;
+    stats.reserve(mClients.size());
+    for (const auto& [client, state] : mClients) stats.push_back(state.stats);
+    return stats;
+}
+
+}  // namespace hardware
+}  // namespace android
@@ -22,7 +22,9 @@
 #include <android/hidl/manager/1.0/BpHwServiceManager.h>
 #include <android/hidl/manager/1.1/BpHwServiceManager.h>
 #include <android/hidl/manager/1.2/BpHwServiceManager.h>
+#include <hidl/CallWatchdog.h>
 #include <hwbinder/IPCThreadState.h>
+#include <hwbinder/binder_kernel.h>
 #include "InternalStatic.h"  // TODO(b/69122224): remove this include, for getOrCreateCachedBinder
 
 // C includes
@@ -31,7 +33,11 @@
 
 // C++ includes
 #include <fstream>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <string>
+#include <string_view>
 
 namespace android {
 namespace hardware {
@@ -156,6 +162,38 @@ status_t readEmbeddedFromParcel(const hidl_string &string ,
     return OK;
 }
 
+status_t readEmbeddedFromParcel(const hidl_string& string, const Parcel& parcel,
+                                size_t parentHandle, size_t parentOffset,
+                                const hidl_string_requirements& requirements,
+                                hidl_string_validation* validation) {
+    status_t status = readEmbeddedFromParcel(string, parcel, parentHandle, parentOffset);
+    if (status != OK) {
+        return status;
+    }
+
+    if (string.size() > requirements.maxSize) {
+        ALOGE("Received hidl_string of %zu bytes, more than the allowed %zu.", string.size(),
+              requirements.maxSize);
+        return BAD_VALUE;
+    }
+
+    hidl_string_validation result = validateHidlString(string);
+    if (validation != nullptr) {
+        *validation = result;
+    }
+
+    if (requirements.noEmbeddedNul && result.hasEmbeddedNul) {
+        ALOGE("Received hidl_string with an embedded NUL.");
+        return BAD_VALUE;
+    }
+    if (requirements.utf8 && !result.isUtf8) {
+        ALOGE("Received hidl_string which is not valid UTF-8.");
+        return BAD_VALUE;
+    }
+
+    return OK;
+}
+
 status_t writeEmbeddedToParcel(const hidl_string &string,
         Parcel *parcel, size_t parentHandle, size_t parentOffset) {
     return parcel->writeEmbeddedBuffer(
@@ -166,6 +204,93 @@ status_t writeEmbeddedToParcel(const hidl_string &string,
             parentOffset + hidl_string::kOffsetOfBuffer);
 }
 
+const size_t hidl_string_list::kOffsetOfChars = offsetof(hidl_string_list, mChars);
+const size_t hidl_string_list::kOffsetOfOffsets = offsetof(hidl_string_list, mOffsets);
+static_assert(hidl_string_list::kOffsetOfChars == 0, "wrong offset");
+static_assert(hidl_string_list::kOffsetOfOffsets == 16, "wrong offset");
+
+status_t readEmbeddedFromParcel(const hidl_string_list& list, const Parcel& parcel,
+                                size_t parentHandle, size_t parentOffset) {
+    size_t childHandle;
+    status_t status = readEmbeddedFromParcel(list.chars(), parcel, parentHandle,
+                                             parentOffset + hidl_string_list::kOffsetOfChars,
+                                             &childHandle);
+    if (status != OK) {
+        return status;
+    }
+
+    status = readEmbeddedFromParcel(list.offsets(), parcel, parentHandle,
+                                    parentOffset + hidl_string_list::kOffsetOfOffsets,
+                                    &childHandle);
+    if (status != OK) {
+        return status;
+    }
+
+    if (!list.isValid()) {
+        ALOGE("Received inconsistent hidl_string_list.");
+        return BAD_VALUE;
+    }
+
+    return OK;
+}
+
+status_t writeEmbeddedToParcel(const hidl_string_list& list, Parcel* parcel, size_t parentHandle,
+                               size_t parentOffset) {
+    size_t childHandle;
+    status_t status = writeEmbeddedToParcel(list.chars(), parcel, parentHandle,
+                                            parentOffset + hidl_string_list::kOffsetOfChars,
+                                            &childHandle);
+    if (status != OK) {
+        return status;
+    }
+
+    return writeEmbeddedToParcel(list.offsets(), parcel, parentHandle,
+                                 parentOffset + hidl_string_list::kOffsetOfOffsets, &childHandle);
+}
+
+// The kernel copies each scatter-gather buffer at 8-byte alignment.
+static size_t alignBuffer(size_t length) {
+    return (length + 7) & ~static_cast<size_t>(7);
+}
+
+ParcelSize computeBufferParcelSize(size_t length) {
+    return ParcelSize{sizeof(binder_buffer_object), 1, alignBuffer(length)};
+}
+
+ParcelSize computeEmbeddedParcelSize(const hidl_handle& handle) {
+    const native_handle_t* nativeHandle = handle.getNativeHandle();
+
+    // writeEmbeddedNativeHandle always writes the handle size.
+    ParcelSize size{sizeof(uint64_t), 0, 0};
+    if (nativeHandle == nullptr) {
+        return size;
+    }
+
+    size += computeBufferParcelSize(sizeof(native_handle_t) +
+                                    sizeof(int) * (nativeHandle->numFds + nativeHandle->numInts));
+    size += ParcelSize{sizeof(binder_fd_array_object), 1, 0};
+    return size;
+}
+
+ParcelSize computeEmbeddedParcelSize(const hidl_memory& memory) {
+    ParcelSize size = computeEmbeddedParcelSize(hidl_handle(memory.handle()));
+    size += computeEmbeddedParcelSize(memory.name());
+    return size;
+}
+
+ParcelSize computeEmbeddedParcelSize(const hidl_string& string) {
+    return computeBufferParcelSize(string.size() + 1);
+}
+
+status_t reserveParcelSize(Parcel* parcel, const ParcelSize& size) {
+    // Parcel has no way to reserve its object table; it still grows geometrically.
+    size_t needed = parcel->dataSize() + size.dataSize;
+    if (needed <= parcel->dataCapacity()) {
+        return OK;
+    }
+    return parcel->setDataCapacity(needed);
+}
+
 status_t readFromParcel(Status *s, const Parcel& parcel) {
     int32_t exception;
     status_t status = parcel.readInt32(&exception);
@@ -230,6 +355,67 @@ __attribute__((no_sanitize("cfi"))) static inline BpHwRefBase* forceGetRefBase(
     return static_cast<BpHwRefBase*>(bpBase);
 }
 
+namespace details {
+
+// Guards gInternedDescriptors, and attaching them to binders.
+static std::mutex& gInternedDescriptorsMutex = *new std::mutex;
+// one entry per interface type, never freed
+static std::set<std::string, std::less<>>& gInternedDescriptors =
+        *new std::set<std::string, std::less<>>;
+// The address is the ID of the interned descriptor attached to a binder.
+static const char kInternedDescriptorId = 0;
+
+// The binder of ifacePtr, if it has one already.
+static sp<IBinder> findCachedBinder(::android::hidl::base::V1_0::IBase* ifacePtr) {
+    if (ifacePtr->isRemote()) {
+        return sp<IBinder>(forceGetRefBase(ifacePtr)->remote());
+    }
+    std::unique_lock<std::mutex> _lock = gBnMap->lock();
+    return gBnMap->getLocked(ifacePtr, nullptr).promote();
+}
+
+static void attachInternedDescriptor(const sp<IBinder>& binder, const char* descriptor) {
+    std::lock_guard<std::mutex> lock(gInternedDescriptorsMutex);
+    // Attaching an ID twice is an error, so check again in case another thread attached it.
+    if (binder->findObject(&kInternedDescriptorId) == nullptr) {
+        binder->attachObject(&kInternedDescriptorId, const_cast<char*>(descriptor),
+                             nullptr /* cleanupCookie */, nullptr /* func */);
+    }
+}
+
+const char* getInternedDescriptor(::android::hidl::base::V1_0::IBase* ifacePtr) {
+    if (ifacePtr == nullptr) {
+        return "";
+    }
+
+    sp<IBinder> binder = findCachedBinder(ifacePtr);
+    if (binder != nullptr) {
+        void* cached = binder->findObject(&kInternedDescriptorId);
+        if (cached != nullptr) {
+            return static_cast<const char*>(cached);
+        }
+    }
+
+    const char* descriptor = "";
+    auto ret = ifacePtr->interfaceDescriptor([&](const hidl_string& name) {
+        std::string_view view(name.c_str(), name.size());
+        std::lock_guard<std::mutex> lock(gInternedDescriptorsMutex);
+        auto it = gInternedDescriptors.find(view);
+        if (it == gInternedDescriptors.end()) {
+            it = gInternedDescriptors.emplace(view).first;
+        }
+        descriptor = it->c_str();
+    });
+    ret.isOk();  // ignored, return empty string if not isOk()
+
+    if (binder != nullptr && descriptor[0] != '\0') {
+        attachInternedDescriptor(binder, descriptor);
+    }
+    return descriptor;
+}
+
+}  // namespace details
+
 sp<IBinder> getOrCreateCachedBinder(::android::hidl::base::V1_0::IBase* ifacePtr) {
     if (ifacePtr == nullptr) {
         return nullptr;
@@ -240,13 +426,22 @@ sp<IBinder> getOrCreateCachedBinder(::android::hidl::base::V1_0::IBase* ifacePtr
         return sp<IBinder>(bpRefBase->remote());
     }
 
-    std::string descriptor = details::getDescriptor(ifacePtr);
-    if (descriptor.empty()) {
+    {
+        // Most calls find the binder, and need no descriptor.
+        std::unique_lock<std::mutex> _lock = details::gBnMap->lock();
+        sp<IBinder> sBnObj = details::gBnMap->getLocked(ifacePtr, nullptr).promote();
+        if (sBnObj != nullptr) {
+            return sBnObj;
+        }
+    }
+
+    const char* descriptor = details::getInternedDescriptor(ifacePtr);
+    if (descriptor[0] == '\0') {
         // interfaceDescriptor fails
         return nullptr;
     }
 
-    // for get + set
+    // for get + set, again in case another thread created the binder meanwhile
     std::unique_lock<std::mutex> _lock = details::gBnMap->lock();
 
     wp<BHwBinder> wBnObj = details::gBnMap->getLocked(ifacePtr, nullptr);
@@ -259,13 +454,14 @@ sp<IBinder> getOrCreateCachedBinder(::android::hidl::base::V1_0::IBase* ifacePtr
             func = details::gBnConstructorMap->get(descriptor, nullptr);
         }
         LOG_ALWAYS_FATAL_IF(func == nullptr, "%s gBnConstructorMap returned null for %s", __func__,
-                            descriptor.c_str());
+                            descriptor);
 
         sBnObj = sp<IBinder>(func(static_cast<void*>(ifacePtr)));
         LOG_ALWAYS_FATAL_IF(sBnObj == nullptr, "%s Bn constructor function returned null for %s",
-                            __func__, descriptor.c_str());
+                            __func__, descriptor);
 
         details::gBnMap->setLocked(ifacePtr, static_cast<BHwBinder*>(sBnObj.get()));
+        details::attachInternedDescriptor(sBnObj, descriptor);
     }
 
     return sBnObj;
@@ -284,6 +480,7 @@ void configureBinderRpcThreadpool(size_t maxThreads, bool callerWillJoin) {
 void joinBinderRpcThreadpool() {
     LOG_ALWAYS_FATAL_IF(!gThreadPoolConfigured,
                         "HIDL joinRpcThreadpool without calling configureRpcThreadPool.");
+    details::resetCallWatchdogThread();
     IPCThreadState::self()->joinThreadPool();
 }
 
@@ -297,6 +494,7 @@ int setupBinderPolling() {
 }
 
 status_t handleBinderPoll() {
+    details::resetCallWatchdogThread();
     return IPCThreadState::self()->handlePolledCommands();
 }
 
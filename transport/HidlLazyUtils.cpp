@@ -48,6 +48,7 @@ class ClientCounterCallback : public ::android::hidl::manager::V1_2::IClientCall
   private:
     struct Service {
         sp<IBase> service;
+        const char* descriptor;  // interned
         std::string name;
         bool clients = false;
         // Used to keep track of unregistered services to allow re-registry
@@ -63,7 +64,7 @@ class ClientCounterCallback : public ::android::hidl::manager::V1_2::IClientCall
     /**
      * Registers or re-registers services. Returns whether successful.
      */
-    bool registerServiceLocked(const sp<IBase>& service, const std::string& name);
+    bool registerServiceLocked(const Service& service);
 
     /**
      * Unregisters all services that we can. If we can't unregister all, re-register other
@@ -109,10 +110,11 @@ class LazyServiceRegistrarImpl {
 bool ClientCounterCallback::addRegisteredService(const sp<IBase>& service,
                                                  const std::string& name) {
     std::lock_guard<std::mutex> lock(mMutex);
-    bool success = registerServiceLocked(service, name);
+    Service entry = {service, getInternedDescriptor(service.get()), name};
+    bool success = registerServiceLocked(entry);
 
     if (success) {
-        mRegisteredServices.push_back({service, name});
+        mRegisteredServices.push_back(std::move(entry));
     }
 
     return success;
@@ -124,26 +126,23 @@ ClientCounterCallback::Service& ClientCounterCallback::assertRegisteredServiceLo
         if (registered.service != service) continue;
         return registered;
     }
-    LOG(FATAL) << "Got callback on service " << getDescriptor(service.get())
+    LOG(FATAL) << "Got callback on service " << getInternedDescriptor(service.get())
                << " which we did not register.";
     __builtin_unreachable();
 }
 
-bool ClientCounterCallback::registerServiceLocked(const sp<IBase>& service,
-                                                  const std::string& name) {
+bool ClientCounterCallback::registerServiceLocked(const Service& entry) {
     auto manager = hardware::defaultServiceManager1_2();
 
-    const std::string descriptor = getDescriptor(service.get());
+    LOG(INFO) << "Registering HAL: " << entry.descriptor << " with name: " << entry.name;
 
-    LOG(INFO) << "Registering HAL: " << descriptor << " with name: " << name;
-
-    status_t res = android::hardware::details::registerAsServiceInternal(service, name);
+    status_t res = android::hardware::details::registerAsServiceInternal(entry.service, entry.name);
     if (res != android::OK) {
         LOG(ERROR) << "Failed to register as service.";
         return false;
     }
 
-    bool ret = manager->registerClientCallback(getDescriptor(service.get()), name, service, this);
+    bool ret = manager->registerClientCallback(entry.descriptor, entry.name, entry.service, this);
     if (!ret) {
         LOG(ERROR) << "Failed to add client callback.";
         return false;
@@ -157,7 +156,7 @@ Return<void> ClientCounterCallback::onClients(const sp<::android::hidl::base::V1
     std::lock_guard<std::mutex> lock(mMutex);
     Service& registered = assertRegisteredServiceLocked(service);
     if (registered.clients == clients) {
-        LOG(FATAL) << "Process already thought " << getDescriptor(service.get()) << "/"
+        LOG(FATAL) << "Process already thought " << registered.descriptor << "/"
                    << registered.name << " had clients: " << registered.clients
                    << " but hwservicemanager has notified has clients: " << clients;
     }
@@ -169,8 +168,8 @@ Return<void> ClientCounterCallback::onClients(const sp<::android::hidl::base::V1
     }
 
     LOG(INFO) << "Process has " << numWithClients << " (of " << mRegisteredServices.size()
-              << " available) client(s) in use after notification " << getDescriptor(service.get())
-              << "/" << registered.name << " has clients: " << clients;
+              << " available) client(s) in use after notification " << registered.descriptor << "/"
+              << registered.name << " has clients: " << clients;
 
     bool handledInCallback = false;
     if (mActiveServicesCallback != nullptr) {
@@ -195,11 +194,10 @@ bool ClientCounterCallback::tryUnregisterLocked() {
     auto manager = hardware::defaultServiceManager1_2();
 
     for (Service& entry : mRegisteredServices) {
-        const std::string descriptor = getDescriptor(entry.service.get());
-        bool success = manager->tryUnregister(descriptor, entry.name, entry.service);
+        bool success = manager->tryUnregister(entry.descriptor, entry.name, entry.service);
 
         if (!success) {
-            LOG(INFO) << "Failed to unregister HAL " << descriptor << "/" << entry.name;
+            LOG(INFO) << "Failed to unregister HAL " << entry.descriptor << "/" << entry.name;
             return false;
         }
 
@@ -217,9 +215,9 @@ void ClientCounterCallback::reRegisterLocked() {
             continue;
         }
 
-        if (!registerServiceLocked(entry.service, entry.name)) {
+        if (!registerServiceLocked(entry)) {
             // Must restart. Otherwise, clients will never be able to get ahold of this service.
-            LOG(FATAL) << "Bad state: could not re-register " << getDescriptor(entry.service.get());
+            LOG(FATAL) << "Bad state: could not re-register " << entry.descriptor;
         }
 
         entry.registered = true;
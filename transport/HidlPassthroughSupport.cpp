@@ -16,26 +16,37 @@
 
 #include <hidl/HidlPassthroughSupport.h>
 
-#include "InternalStatic.h"  // TODO(b/69122224): remove this include, for tryWrap
+#include "InternalStatic.h"  // TODO(b/69122224): remove this include, for gBsConstructorMap
 
 #include <hidl/HidlTransportUtils.h>
 #include <hidl/Static.h>
 
+#include <functional>
+#include <string>
+
 using ::android::hidl::base::V1_0::IBase;
 
 namespace android {
 namespace hardware {
 namespace details {
 
-static sp<IBase> tryWrap(const std::string& descriptor, sp<IBase> iface) {
-    auto func = getBsConstructorMap().get(descriptor, nullptr);
-    if (!func) {
-        // TODO(b/69122224): remove this when prebuilts don't reference it
-        func = gBsConstructorMap->get(descriptor, nullptr);
-    }
-    if (func) {
-        return func(static_cast<void*>(iface.get()));
+using BsConstructor = std::function<sp<IBase>(void*)>;
+
+// Constructor in map of the first of descriptors[first, limit) which has one, and its index in
+// *index, or an empty function and limit. Takes the map's lock once, rather than once per
+// descriptor.
+static BsConstructor findConstructor(BsConstructorMap& map,
+                                     const hidl_vec<hidl_string>& descriptors, size_t first,
+                                     size_t limit, size_t* index) {
+    auto lock = map.lock();
+    for (size_t i = first; i < limit; ++i) {
+        BsConstructor func = map.getLocked(descriptors[i], nullptr);
+        if (func) {
+            *index = i;
+            return func;
+        }
     }
+    *index = limit;
     return nullptr;
 }
 
@@ -54,13 +65,34 @@ sp<IBase> wrapPassthroughInternal(sp<IBase> iface) {
     // Therefore, we try to wrap using the descript names of the parent
     // types along the interface chain, instead of always using the descriptor
     // name of the current interface.
+    //
+    // Descriptors without a constructor are skipped taking each map's lock once, and the
+    // constructor found is called outside of the locks.
     sp<IBase> base;
     auto ret = iface->interfaceChain([&](const auto& types) {
-        for (const std::string& descriptor : types) {
-            base = tryWrap(descriptor, iface);
+        size_t i = 0;
+        while (i < types.size()) {
+            size_t found;
+            BsConstructor func = findConstructor(getBsConstructorMap(), types, i, types.size(),
+                                                 &found);
+            // TODO(b/69122224): remove this when prebuilts don't reference it
+            // Only descriptors before the one found above have no constructor in the new map.
+            if (found > i) {
+                size_t legacyFound;
+                BsConstructor legacy =
+                        findConstructor(gBsConstructorMap.get(), types, i, found, &legacyFound);
+                if (legacy) {
+                    func = std::move(legacy);
+                    found = legacyFound;
+                }
+            }
+            if (!func) break;
+
+            base = func(static_cast<void*>(iface.get()));
             if (base != nullptr) {
                 break;  // wrap is successful. no need to lookup further.
             }
+            i = found + 1;
         }
     });
 
@@ -16,6 +16,8 @@
 
 #include <hidl/HidlTransportUtils.h>
 
+#include <string.h>
+
 #include <android/hidl/base/1.0/IBase.h>
 
 namespace android {
@@ -31,7 +33,7 @@ Return<bool> canCastInterface(IBase* interface, const char* castTo, bool emitErr
 
     // b/68217907
     // Every HIDL interface is a base interface.
-    if (std::string(IBase::descriptor) == castTo) {
+    if (strcmp(IBase::descriptor, castTo) == 0) {
         return true;
     }
 
@@ -16,6 +16,10 @@
 
 #define LOG_TAG "LegacySupport"
 
+#include <thread>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
 #include <android/hidl/base/1.0/IBase.h>
 #include <hidl/HidlSupport.h>
 #include <hidl/LegacySupport.h>
@@ -82,4 +86,115 @@ __attribute__((warn_unused_result)) status_t registerPassthroughServiceImplement
             serviceName);
 }
 
+bool parsePassthroughServiceConfig(const std::string& content,
+                                   std::vector<PassthroughServiceEntry>* entries,
+                                   std::string* error) {
+    entries->clear();
+    std::vector<std::string> lines = base::Split(content, "\n");
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string line = lines[i].substr(0, lines[i].find('#'));
+        std::vector<std::string> fields;
+        for (const std::string& field : base::Split(base::Trim(line), " \t")) {
+            if (!field.empty()) fields.push_back(field);
+        }
+        if (fields.empty()) continue;
+
+        PassthroughServiceEntry entry;
+        entry.interfaceName = fields[0];
+        size_t at = entry.interfaceName.find('@');
+        if (at == std::string::npos || entry.interfaceName.find("::", at) == std::string::npos) {
+            *error = "line " + std::to_string(i + 1) + ": " + fields[0] +
+                     " is not a fully-qualified interface name";
+            return false;
+        }
+        size_t next = 1;
+        if (next < fields.size() && fields[next] != "lazy") {
+            entry.serviceName = fields[next++];
+        }
+        if (next < fields.size() && fields[next] == "lazy") {
+            entry.lazy = true;
+            next++;
+        }
+        if (next < fields.size()) {
+            *error = "line " + std::to_string(i + 1) + ": unexpected " + fields[next];
+            return false;
+        }
+        entries->push_back(std::move(entry));
+    }
+    return true;
+}
+
+__attribute__((warn_unused_result)) status_t registerPassthroughServiceImplementations(
+        const std::vector<PassthroughServiceEntry>& entries) {
+    size_t lazy = 0;
+    for (const PassthroughServiceEntry& entry : entries) {
+        if (entry.lazy) lazy++;
+    }
+    if (lazy != 0 && lazy != entries.size()) {
+        ALOGE("Cannot host lazy and non-lazy passthrough services in the same process.");
+        return BAD_VALUE;
+    }
+
+    // Each registration loads a library and waits on hwservicemanager, so they are started
+    // together rather than one after another.
+    std::vector<status_t> results(entries.size(), OK);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        threads.emplace_back([&entries, &results, i] {
+            const PassthroughServiceEntry& entry = entries[i];
+            if (entry.lazy) {
+                results[i] = details::registerPassthroughServiceImplementation(
+                        entry.interfaceName, entry.interfaceName,
+                        [](const sp<IBase>& service, const std::string& name) {
+                            return LazyServiceRegistrar::getInstance().registerService(service,
+                                                                                       name);
+                        },
+                        entry.serviceName);
+            } else {
+                results[i] = registerPassthroughServiceImplementation(
+                        entry.interfaceName, entry.interfaceName, entry.serviceName);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (status_t result : results) {
+        if (result != OK) return result;
+    }
+    return OK;
+}
+
+__attribute__((warn_unused_result)) status_t defaultPassthroughServiceHost(
+        const std::string& configPath, size_t maxThreads) {
+    std::string content;
+    if (!base::ReadFileToString(configPath, &content)) {
+        ALOGE("Could not read passthrough host configuration %s.", configPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::vector<PassthroughServiceEntry> entries;
+    std::string error;
+    if (!parsePassthroughServiceConfig(content, &entries, &error)) {
+        ALOGE("Malformed passthrough host configuration %s: %s", configPath.c_str(),
+              error.c_str());
+        return EXIT_FAILURE;
+    }
+    if (entries.empty()) {
+        ALOGE("Passthrough host configuration %s lists no services.", configPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    configureRpcThreadpool(maxThreads != 0 ? maxThreads : entries.size(), true);
+    status_t result = registerPassthroughServiceImplementations(entries);
+
+    if (result != OK) {
+        return result;
+    }
+
+    joinRpcThreadpool();
+    return UNKNOWN_ERROR;
+}
+
 }  // namespace android::hardware
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HidlManifestIndex"
+
+#include <hidl/ManifestIndex.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/unique_fd.h>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+static constexpr char kMagic[8] = {'H', 'I', 'D', 'L', 'I', 'D', 'X', '\0'};
+static constexpr uint32_t kVersion = 1;
+
+// Not in /system/etc/vintf, which libvintf expects to only hold manifests and matrices.
+static constexpr const char* kDeviceIndexPath = "/system/etc/hidl/hidl_manifest_index.bin";
+
+// The file is a Header, then entryCount RawEntrys sorted by key, then stringsSize bytes of keys.
+// A key is "package@major::IInterface/instance".
+struct ManifestIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;  // none yet
+    uint32_t entryCount;
+    uint32_t stringsSize;
+};
+
+struct ManifestIndex::RawEntry {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t minor;
+    uint8_t transport;
+    uint8_t pad[3];
+};
+
+static_assert(sizeof(ManifestIndex::Transport) == 1, "Transport is stored in a byte");
+
+static std::string keyPrefix(const std::string& package, uint32_t major,
+                             const std::string& interface) {
+    return package + "@" + std::to_string(major) + "::" + interface + "/";
+}
+
+// Splits package@major.minor::IInterface.
+static bool parseFqName(const std::string& fqName, std::string* prefix, uint32_t* minor) {
+    size_t at = fqName.find('@');
+    size_t colons = fqName.find("::", at);
+    if (at == std::string::npos || colons == std::string::npos) return false;
+
+    std::string version = fqName.substr(at + 1, colons - at - 1);
+    size_t dot = version.find('.');
+    if (dot == std::string::npos) return false;
+
+    uint32_t major;
+    if (!base::ParseUint(version.substr(0, dot), &major)) return false;
+    if (!base::ParseUint(version.substr(dot + 1), minor)) return false;
+
+    *prefix = keyPrefix(fqName.substr(0, at), major, fqName.substr(colons + 2));
+    return true;
+}
+
+std::string ManifestIndex::build(std::vector<Entry> entries) {
+    struct Keyed {
+        std::string key;
+        uint32_t minor;
+        Transport transport;
+    };
+    std::vector<Keyed> keyed;
+    keyed.reserve(entries.size());
+    for (const Entry& entry : entries) {
+        keyed.push_back({keyPrefix(entry.package, entry.major, entry.interface) + entry.instance,
+                         entry.minor, entry.transport});
+    }
+
+    // Keep the highest minor version of each instance, like hwservicemanager does.
+    std::sort(keyed.begin(), keyed.end(), [](const Keyed& a, const Keyed& b) {
+        return a.key != b.key ? a.key < b.key : a.minor > b.minor;
+    });
+    keyed.erase(std::unique(keyed.begin(), keyed.end(),
+                            [](const Keyed& a, const Keyed& b) { return a.key == b.key; }),
+                keyed.end());
+
+    std::string strings;
+    std::vector<RawEntry> rawEntries;
+    for (const Keyed& k : keyed) {
+        RawEntry raw = {};
+        raw.keyOffset = static_cast<uint32_t>(strings.size());
+        raw.keyLength = static_cast<uint32_t>(k.key.size());
+        raw.minor = k.minor;
+        raw.transport = static_cast<uint8_t>(k.transport);
+        rawEntries.push_back(raw);
+        strings += k.key;
+    }
+
+    Header header = {};
+    memcpy(header.magic, kMagic, sizeof(header.magic));
+    header.version = kVersion;
+    header.entryCount = static_cast<uint32_t>(rawEntries.size());
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char*>(rawEntries.data()),
+                rawEntries.size() * sizeof(RawEntry));
+    data += strings;
+    return data;
+}
+
+std::unique_ptr<ManifestIndex> ManifestIndex::open(const std::string& path) {
+    base::unique_fd fd(TEMP_FAILURE_RETRY(::open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return nullptr;
+    size_t size = static_cast<size_t>(st.st_size);
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        PLOG(ERROR) << "Could not map " << path;
+        return nullptr;
+    }
+
+    std::unique_ptr<ManifestIndex> index(new ManifestIndex());
+    index->mMapping = mapping;
+    index->mMappingSize = size;
+    if (!index->init(static_cast<const uint8_t*>(mapping), size)) {
+        LOG(ERROR) << "Ignoring malformed manifest index " << path;
+        return nullptr;
+    }
+    return index;
+}
+
+std::unique_ptr<ManifestIndex> ManifestIndex::fromData(std::string data) {
+    std::unique_ptr<ManifestIndex> index(new ManifestIndex());
+    index->mData = std::move(data);
+    if (!index->init(reinterpret_cast<const uint8_t*>(index->mData.data()), index->mData.size())) {
+        return nullptr;
+    }
+    return index;
+}
+
+ManifestIndex::~ManifestIndex() {
+    if (mMapping != nullptr) {
+        munmap(mMapping, mMappingSize);
+    }
+}
+
+bool ManifestIndex::init(const uint8_t* data, size_t length) {
+    if (length < sizeof(Header)) return false;
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion) {
+        return false;
+    }
+
+    size_t entriesSize = static_cast<size_t>(header->entryCount) * sizeof(RawEntry);
+    if (length != sizeof(Header) + entriesSize + header->stringsSize) return false;
+
+    const RawEntry* entries = reinterpret_cast<const RawEntry*>(data + sizeof(Header));
+    for (size_t i = 0; i < header->entryCount; ++i) {
+        if (entries[i].keyOffset > header->stringsSize ||
+            entries[i].keyLength > header->stringsSize - entries[i].keyOffset) {
+            return false;
+        }
+    }
+
+    mHeader = header;
+    mEntries = entries;
+    mStrings = reinterpret_cast<const char*>(data + sizeof(Header) + entriesSize);
+
+    // lookups rely on the order
+    for (size_t i = 1; i < size(); ++i) {
+        if (!(keyOf(i - 1) < keyOf(i))) return false;
+    }
+    return true;
+}
+
+size_t ManifestIndex::size() const {
+    return mHeader->entryCount;
+}
+
+std::string ManifestIndex::keyOf(size_t index) const {
+    return std::string(mStrings + mEntries[index].keyOffset, mEntries[index].keyLength);
+}
+
+size_t ManifestIndex::lowerBound(const std::string& key) const {
+    size_t low = 0;
+    size_t high = size();
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const RawEntry& entry = mEntries[mid];
+        if (key.compare(0, std::string::npos, mStrings + entry.keyOffset, entry.keyLength) > 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+bool ManifestIndex::getTransport(const std::string& fqName, const std::string& instance,
+                                 Transport* transport) const {
+    std::string key;
+    uint32_t minor;
+    if (!parseFqName(fqName, &key, &minor)) return false;
+    key += instance;
+
+    size_t i = lowerBound(key);
+    if (i < size() &&
+        key.compare(0, std::string::npos, mStrings + mEntries[i].keyOffset,
+                    mEntries[i].keyLength) == 0 &&
+        mEntries[i].minor >= minor) {
+        *transport = static_cast<Transport>(mEntries[i].transport);
+        return true;
+    }
+    return false;
+}
+
+void ManifestIndex::forEachEntry(
+        const std::function<void(const std::string&, const std::string&, Transport)>& f) const {
+    for (size_t i = 0; i < size(); ++i) {
+        std::string key = keyOf(i);
+        size_t colons = key.find("::");
+        size_t slash = key.find('/', colons);
+        std::string fqName = key.substr(0, colons) + "." + std::to_string(mEntries[i].minor) +
+                             key.substr(colons, slash - colons);
+        f(fqName, key.substr(slash + 1), static_cast<Transport>(mEntries[i].transport));
+    }
+}
+
+const ManifestIndex* getManifestIndex() {
+    static const ManifestIndex* index = ManifestIndex::open(kDeviceIndexPath).release();
+    return index;
+}
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
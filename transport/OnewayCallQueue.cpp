@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HidlOnewayCallQueue"
+
+#include <hidl/OnewayCallQueue.h>
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+#include <utils/AndroidThreads.h>
+
+namespace android {
+namespace hardware {
+
+using ::android::hidl::base::V1_0::IBase;
+
+OnewayCallQueue::OnewayCallQueue() : OnewayCallQueue(Config{}) {}
+
+OnewayCallQueue::OnewayCallQueue(const Config& config) : mConfig(config) {
+    CHECK_GT(mConfig.maxCalls, 0u) << "A batch must hold at least one call";
+    mThread = std::thread([this] { run(); });
+}
+
+OnewayCallQueue::~OnewayCallQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWork.notify_one();
+    mThread.join();
+}
+
+bool OnewayCallQueue::enqueue(const sp<IBase>& target, Call call, size_t bytes,
+                              uint64_t coalescingKey) {
+    if (target == nullptr || !call) return false;
+
+    bool due;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Target& entry = mTargets[target.get()];
+        if (entry.target == nullptr) entry.target = target;
+
+        if (coalescingKey != kNoCoalescing) {
+            // The new call goes to the back rather than into the superseded call's place, so
+            // that it is not sent before calls which were queued ahead of it.
+            auto superseded = std::find_if(
+                    entry.calls.begin(), entry.calls.end(),
+                    [&](const Pending& p) { return p.coalescingKey == coalescingKey; });
+            if (superseded != entry.calls.end()) {
+                entry.bytes -= superseded->bytes;
+                entry.calls.erase(superseded);
+                mStats.coalesced++;
+                if (mFlushing > 0) mIdle.notify_all();
+            }
+        }
+
+        entry.calls.push_back({++mLastQueued, std::move(call), bytes, coalescingKey, Clock::now()});
+        entry.bytes += bytes;
+        mStats.queued++;
+        due = entry.calls.size() >= mConfig.maxCalls ||
+              (mConfig.maxBytes > 0 && entry.bytes >= mConfig.maxBytes);
+    }
+
+    // The thread waits for the oldest call's deadline, so it only needs waking early.
+    if (due) mWork.notify_one();
+    return true;
+}
+
+void OnewayCallQueue::flush() {
+    CHECK(std::this_thread::get_id() != mThread.get_id())
+            << "flush called from a queued call would wait for itself";
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    uint64_t seq = mLastQueued;
+    if (isSentLocked(seq)) return;
+    mFlushUpTo = std::max(mFlushUpTo, seq);
+    mFlushing++;
+    mWork.notify_one();
+    mIdle.wait(lock, [&] { return isSentLocked(seq); });
+    mFlushing--;
+}
+
+OnewayCallQueue::Stats OnewayCallQueue::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+bool OnewayCallQueue::isDueLocked(const Target& target, Clock::time_point now) const {
+    if (target.calls.empty()) return false;
+    if (mStopping || target.calls.front().seq <= mFlushUpTo) return true;
+    return target.calls.size() >= mConfig.maxCalls ||
+           (mConfig.maxBytes > 0 && target.bytes >= mConfig.maxBytes) ||
+           now - target.calls.front().queuedAt >= mConfig.maxDelay;
+}
+
+bool OnewayCallQueue::isSentLocked(uint64_t seq) const {
+    // A target's calls are queued in order, so only the first of each needs checking.
+    if (mSendingFrom != 0 && mSendingFrom <= seq) return false;
+    return std::all_of(mTargets.begin(), mTargets.end(), [seq](const auto& entry) {
+        return entry.second.calls.empty() || entry.second.calls.front().seq > seq;
+    });
+}
+
+OnewayCallQueue::TargetMap::iterator OnewayCallQueue::nextDueLocked(Clock::time_point now,
+                                                                    Clock::time_point* wakeAt) {
+    *wakeAt = Clock::time_point::max();
+    auto start = mTargets.upper_bound(mLastSent);
+    for (size_t i = 0; i < mTargets.size(); ++i, ++start) {
+        if (start == mTargets.end()) start = mTargets.begin();
+        const Target& target = start->second;
+        if (isDueLocked(target, now)) return start;
+        if (!target.calls.empty()) {
+            *wakeAt = std::min(*wakeAt, target.calls.front().queuedAt + mConfig.maxDelay);
+        }
+    }
+    return mTargets.end();
+}
+
+void OnewayCallQueue::run() {
+    androidSetThreadName("HIDL OnewayCallQueue");
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        Clock::time_point wakeAt;
+        auto due = nextDueLocked(Clock::now(), &wakeAt);
+        if (due == mTargets.end()) {
+            if (mStopping) break;
+            if (wakeAt == Clock::time_point::max()) {
+                mWork.wait(lock);
+            } else {
+                mWork.wait_until(lock, wakeAt);
+            }
+            continue;
+        }
+
+        const IBase* key = due->first;
+        std::deque<Pending> batch;
+        batch.swap(due->second.calls);
+        due->second.bytes = 0;
+        mLastSent = key;
+        mSendingFrom = batch.front().seq;
+        mStats.batches++;
+        lock.unlock();
+
+        uint64_t sent = 0;
+        uint64_t failed = 0;
+        bool dead = false;
+        for (Pending& pending : batch) {
+            Return<void> ret = pending.call();
+            sent++;
+            if (!ret.isOk()) {
+                failed++;
+                if (ret.isDeadObject()) {
+                    dead = true;
+                    break;
+                }
+                LOG(WARNING) << "Queued oneway call failed: " << ret.description();
+            }
+        }
+        size_t dropped = batch.size() - sent;
+        batch.clear();  // destroys the calls' captures without the lock
+
+        lock.lock();
+        mSendingFrom = 0;
+        due = mTargets.find(key);
+        if (dead) {
+            dropped += due->second.calls.size();
+            due->second.calls.clear();
+            due->second.bytes = 0;
+            if (dropped > 0) {
+                LOG(WARNING) << "Target of queued oneway calls died, dropped " << dropped;
+            }
+        }
+        mStats.sent += sent;
+        mStats.failed += failed + dropped;
+        // Keeping the entry would keep the target alive.
+        if (due->second.calls.empty()) mTargets.erase(due);
+        if (mFlushing > 0) mIdle.notify_all();
+    }
+    mIdle.notify_all();
+}
+
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HidlResponseCache"
+
+#include <hidl/ResponseCache.h>
+
+#include <android-base/logging.h>
+
+namespace android {
+namespace hardware {
+
+using ::android::hidl::base::V1_0::IBase;
+
+sp<ResponseCache> ResponseCache::create(const sp<IBase>& service) {
+    CHECK(service != nullptr) << "Cannot cache the responses of a null service";
+
+    sp<ResponseCache> cache = new ResponseCache(service);
+    // Objects in this process do not die, so there is nothing to link to for them.
+    if (service->isRemote()) {
+        Return<bool> linked = service->linkToDeath(cache, 0 /* cookie */);
+        if (!linked.isOk() || !linked) {
+            // It is dead already, or will be when it is next called, and errors are not cached.
+            LOG(WARNING) << "Could not link to the death of the cached service: "
+                         << linked.description();
+        } else {
+            std::lock_guard<std::mutex> lock(cache->mMutex);
+            cache->mLinked = true;
+        }
+    }
+    return cache;
+}
+
+void ResponseCache::close() {
+    bool linked;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mClosed) return;
+        mClosed = true;
+        linked = mLinked;
+        mLinked = false;
+        for (auto& [name, method] : mMethods) invalidateLocked(&method);
+        mGeneration++;
+    }
+    // Not under the lock, since the service may be dying and calling serviceDied.
+    if (linked) {
+        Return<bool> unlinked = mService->unlinkToDeath(this);
+        if (!unlinked.isOk()) {
+            LOG(WARNING) << "Could not unlink from the death of the cached service: "
+                         << unlinked.description();
+        }
+    }
+}
+
+ResponseCache::ResponseCache(const sp<IBase>& service) : mService(service) {}
+
+void ResponseCache::setTtl(const std::string& method, std::chrono::nanoseconds ttl) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Method& m = mMethods[method];
+    m.ttl = ttl;
+    m.stats.method = method;
+    invalidateLocked(&m);
+}
+
+void ResponseCache::invalidate(const std::string& method) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mMethods.find(method);
+    if (it != mMethods.end()) invalidateLocked(&it->second);
+    mGeneration++;
+}
+
+void ResponseCache::invalidateAll() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& [name, method] : mMethods) invalidateLocked(&method);
+    mGeneration++;
+}
+
+void ResponseCache::invalidateLocked(Method* method) {
+    if (!method->cached) return;
+    if (Clock::now() < method->entry.expires) method->stats.invalidations++;
+    method->cached = false;
+    method->entry = Entry{};
+}
+
+std::vector<ResponseCache::MethodStats> ResponseCache::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<MethodStats> stats;
+    stats.reserve(mMethods.size());
+    for (const auto& [name, method] : mMethods) stats.push_back(method.stats);
+    return stats;
+}
+
+std::shared_ptr<const void> ResponseCache::lookup(const std::string& method, const void* type,
+                                                  uint64_t* generation) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Method& m = mMethods[method];
+    m.stats.method = method;
+    *generation = mGeneration;
+
+    if (mClosed) return nullptr;
+    if (m.cached && Clock::now() >= m.entry.expires) {
+        m.cached = false;
+        m.entry = Entry{};
+    }
+    if (!m.cached) {
+        m.stats.misses++;
+        return nullptr;
+    }
+    CHECK(m.entry.type == type) << "Responses of " << method << " cached with another type";
+    m.stats.hits++;
+    return m.entry.value;
+}
+
+void ResponseCache::store(const std::string& method, const void* type, uint64_t generation,
+                          std::shared_ptr<const void> value) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mClosed || generation != mGeneration) return;
+
+    Method& m = mMethods[method];
+    if (m.ttl.count() <= 0) return;
+    Clock::time_point now = Clock::now();
+    Clock::time_point expires = m.ttl >= Clock::time_point::max() - now
+                                        ? Clock::time_point::max()
+                                        : now + std::chrono::duration_cast<Clock::duration>(m.ttl);
+    m.entry = Entry{std::move(value), type, expires};
+    m.cached = true;
+}
+
+Return<void> ResponseCache::interfaceChain(IBase::interfaceChain_cb _hidl_cb) {
+    return getWithCallback<hidl_vec<hidl_string>>(
+            "interfaceChain", [this](auto cb) { return mService->interfaceChain(cb); }, _hidl_cb);
+}
+
+Return<void> ResponseCache::interfaceDescriptor(IBase::interfaceDescriptor_cb _hidl_cb) {
+    return getWithCallback<hidl_string>(
+            "interfaceDescriptor", [this](auto cb) { return mService->interfaceDescriptor(cb); },
+            _hidl_cb);
+}
+
+Return<void> ResponseCache::getHashChain(IBase::getHashChain_cb _hidl_cb) {
+    return getWithCallback<hidl_vec<hidl_array<uint8_t, 32>>>(
+            "getHashChain", [this](auto cb) { return mService->getHashChain(cb); }, _hidl_cb);
+}
+
+void ResponseCache::serviceDied(uint64_t /* cookie */, const wp<IBase>& /* who */) {
+    LOG(INFO) << "Cached service died, dropping its responses";
+    invalidateAll();
+}
+
+}  // namespace hardware
+}  // namespace android
@@ -23,8 +23,11 @@
 #include <condition_variable>
 #include <dlfcn.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <fstream>
 #include <pthread.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <mutex>
@@ -34,6 +37,7 @@
 #include <hidl/HidlBinderSupport.h>
 #include <hidl/HidlInternal.h>
 #include <hidl/HidlTransportUtils.h>
+#include <hidl/ManifestIndex.h>
 #include <hidl/ServiceManagement.h>
 #include <hidl/Status.h>
 #include <utils/SystemClock.h>
@@ -44,6 +48,7 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <hwbinder/IPCThreadState.h>
 #include <hwbinder/Parcel.h>
 #if !defined(__ANDROID_RECOVERY__) && defined(__ANDROID__)
@@ -85,13 +90,21 @@ static void waitForHwServiceManager() {
 #endif  // __ANDROID__
 }
 
-static std::string binaryName() {
-    std::ifstream ifs("/proc/self/cmdline");
-    std::string cmdline;
-    if (!ifs) {
+static std::string readBinaryName() {
+    base::unique_fd fd(TEMP_FAILURE_RETRY(open("/proc/self/cmdline", O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) {
         return "";
     }
-    ifs >> cmdline;
+
+    char buf[PATH_MAX];
+    ssize_t n = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf) - 1));
+    if (n <= 0) {
+        return "";
+    }
+    buf[n] = '\0';
+
+    // argv[0], which ends at the first '\0'
+    std::string cmdline(buf);
 
     size_t idx = cmdline.rfind('/');
     if (idx != std::string::npos) {
@@ -101,20 +114,75 @@ static std::string binaryName() {
     return cmdline;
 }
 
+static const std::string& binaryName() {
+    static const std::string name = readBinaryName();
+    return name;
+}
+
 static std::string packageWithoutVersion(const std::string& packageAndVersion) {
     size_t at = packageAndVersion.find('@');
     if (at == std::string::npos) return packageAndVersion;
     return packageAndVersion.substr(0, at);
 }
 
+// Renames every thread of this process whose name is a prefix of descriptor to newName, returning
+// how many were renamed.
+static size_t renameThreads(const std::string& descriptor, const std::string& newName) {
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir("/proc/self/task"), closedir);
+    if (dir == nullptr) return 0;
+
+    size_t renamed = 0;
+    dirent* dp;
+    while ((dp = readdir(dir.get())) != nullptr) {
+        if (dp->d_type != DT_DIR) continue;
+        if (dp->d_name[0] == '.') continue;
+
+        char path[NAME_MAX + sizeof("/comm")];
+        snprintf(path, sizeof(path), "%s/comm", dp->d_name);
+        base::unique_fd fd(
+                TEMP_FAILURE_RETRY(openat(dirfd(dir.get()), path, O_RDWR | O_CLOEXEC)));
+        if (fd == -1) {
+            ALOGI("Could not rename process, failed read comm for %s.", dp->d_name);
+            continue;
+        }
+
+        // comm is at most 16 bytes including its terminator, followed by '\n'
+        char comm[32];
+        ssize_t n = TEMP_FAILURE_RETRY(read(fd, comm, sizeof(comm) - 1));
+        if (n <= 0) continue;
+        comm[n] = '\0';
+        size_t commLength = strcspn(comm, " \t\n");
+        if (commLength == 0) continue;
+
+        // don't rename if it already has an explicit name
+        if (descriptor.compare(0, commLength, comm, commLength) != 0) continue;
+
+        // comm does not support pwrite, but replaces the whole name regardless of position.
+        if (TEMP_FAILURE_RETRY(write(fd, newName.data(), newName.size())) >= 0) {
+            renamed++;
+        }
+    }
+
+    return renamed;
+}
+
+// If this binary is in descriptor's package, e.x. android.hardware.foo@1.0-service registering
+// android.hardware.foo@1.0::IFoo, threads still named after the binary are renamed to drop the
+// namespace (foo@1.0-service). This is done at most once per process.
 __attribute__((noinline)) static void tryShortenProcessName(const std::string& descriptor) {
-    const static std::string kTasks = "/proc/self/task/";
+    // Threads created after the rename inherit the new name, so walk the tasks only once.
+    static std::mutex gMutex;
+    static bool gShortened = false;
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    if (gShortened) return;
 
     // make sure that this binary name is in the same package
-    std::string processName = binaryName();
+    const std::string& processName = binaryName();
+    static const std::string kProcessPackage = packageWithoutVersion(processName);
 
     // e.x. android.hardware.foo is this package
-    if (!base::StartsWith(packageWithoutVersion(processName), packageWithoutVersion(descriptor))) {
+    if (!base::StartsWith(kProcessPackage, packageWithoutVersion(descriptor))) {
         return;
     }
 
@@ -123,33 +191,13 @@ __attribute__((noinline)) static void tryShortenProcessName(const std::string& d
     if (lastDot == std::string::npos) return;
     size_t secondDot = descriptor.rfind('.', lastDot - 1);
     if (secondDot == std::string::npos) return;
+    if (secondDot + 1 > processName.size()) return;
 
     std::string newName = processName.substr(secondDot + 1, std::string::npos);
     ALOGI("Removing namespace from process name %s to %s.", processName.c_str(), newName.c_str());
 
-    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kTasks.c_str()), closedir);
-    if (dir == nullptr) return;
-
-    dirent* dp;
-    while ((dp = readdir(dir.get())) != nullptr) {
-        if (dp->d_type != DT_DIR) continue;
-        if (dp->d_name[0] == '.') continue;
-
-        std::fstream fs(kTasks + dp->d_name + "/comm");
-        if (!fs) {
-            ALOGI("Could not rename process, failed read comm for %s.", dp->d_name);
-            continue;
-        }
-
-        std::string oldComm;
-        if (!(fs >> oldComm)) continue;
-
-        // don't rename if it already has an explicit name
-        if (base::StartsWith(descriptor, oldComm)) {
-            if (!fs.seekg(0, fs.beg)) continue;
-            fs << newName;
-        }
-    }
+    renameThreads(descriptor, newName);
+    gShortened = true;
 }
 
 namespace details {
@@ -169,6 +217,26 @@ void setTrebleTestingOverride(bool testingOverride) {
     *getTrebleTestingOverridePtr() = testingOverride;
 }
 
+static std::mutex& getPassthroughLibraryPathsMutex() {
+    static std::mutex* gPassthroughLibraryPathsMutex = new std::mutex;
+    return *gPassthroughLibraryPathsMutex;
+}
+
+static std::vector<std::string>* getPassthroughLibraryPathsPtr() {
+    static std::vector<std::string>* gPassthroughLibraryPaths = new std::vector<std::string>;
+    return gPassthroughLibraryPaths;
+}
+
+void setPassthroughLibraryPaths(const std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lock(getPassthroughLibraryPathsMutex());
+    *getPassthroughLibraryPathsPtr() = paths;
+}
+
+static std::vector<std::string> getPassthroughLibraryPaths() {
+    std::lock_guard<std::mutex> lock(getPassthroughLibraryPathsMutex());
+    return *getPassthroughLibraryPathsPtr();
+}
+
 static bool isDebuggable() {
     static bool debuggable = base::GetBoolProperty("ro.debuggable", false);
     return debuggable;
@@ -479,6 +547,10 @@ struct PassthroughServiceManager : IServiceManager1_1 {
             HAL_LIBRARY_PATH_SYSTEM,
 #endif
         };
+        const std::vector<std::string> overridePaths = details::getPassthroughLibraryPaths();
+        if (!overridePaths.empty()) {
+            paths = overridePaths;
+        }
 
         if (details::isTrebleTestingOverride()) {
             // Load HAL implementations that are statically linked
@@ -503,6 +575,9 @@ struct PassthroughServiceManager : IServiceManager1_1 {
                 } else {
 #if !defined(__ANDROID_RECOVERY__) && defined(__ANDROID__)
                     handle = android_load_sphal_library(fullPath.c_str(), dlMode);
+#else
+                    // There is no sphal namespace on host, e.x. for overridden paths in benchmarks.
+                    handle = dlopen(fullPath.c_str(), dlMode);
 #endif
                 }
 
@@ -623,8 +698,16 @@ struct PassthroughServiceManager : IServiceManager1_1 {
                  HAL_LIBRARY_PATH_SYSTEM_32BIT,
 #endif
              }}};
+        std::vector<std::pair<Arch, std::vector<const char*>>> overridePaths;
+        const std::vector<std::string> overrideDirs = details::getPassthroughLibraryPaths();
+        for (const std::string& path : overrideDirs) {
+            if (overridePaths.empty()) {
+                overridePaths.push_back({sizeof(void*) == 8 ? Arch::IS_64BIT : Arch::IS_32BIT, {}});
+            }
+            overridePaths.front().second.push_back(path.c_str());
+        }
         std::map<std::string, InstanceDebugInfo> map;
-        for (const auto &pair : sAllPaths) {
+        for (const auto &pair : overridePaths.empty() ? sAllPaths : overridePaths) {
             Arch arch = pair.first;
             for (const auto &path : pair.second) {
                 std::vector<std::string> libs = findFiles(path, "", ".so");
@@ -854,31 +937,80 @@ bool handleCastError(const Return<bool>& castReturn, const std::string& descript
     return false;
 }
 
+// Resolves the transport from the manifest index, if it has an answer.
+static bool getLocalTransport(const std::string& descriptor, const std::string& instance,
+                              IServiceManager1_0::Transport* transport) {
+    using Transport = IServiceManager1_0::Transport;
+    static_assert(static_cast<uint8_t>(ManifestIndex::Transport::EMPTY) ==
+                  static_cast<uint8_t>(Transport::EMPTY));
+    static_assert(static_cast<uint8_t>(ManifestIndex::Transport::HWBINDER) ==
+                  static_cast<uint8_t>(Transport::HWBINDER));
+    static_assert(static_cast<uint8_t>(ManifestIndex::Transport::PASSTHROUGH) ==
+                  static_cast<uint8_t>(Transport::PASSTHROUGH));
+
+    const ManifestIndex* index = getManifestIndex();
+    ManifestIndex::Transport local;
+    if (index == nullptr || !index->getTransport(descriptor, instance, &local)) {
+        return false;
+    }
+    *transport = static_cast<Transport>(local);
+    return true;
+}
+
+// The manifest index only describes the device's own service manager, so it is not consulted
+// for others.
+static sp<::android::hidl::base::V1_0::IBase> getRawServiceFrom(const sp<IServiceManager1_1>& sm,
+                                                                const std::string& descriptor,
+                                                                const std::string& instance,
+                                                                bool retry, bool getStub,
+                                                                bool useManifestIndex);
+
 sp<::android::hidl::base::V1_0::IBase> getRawServiceInternal(const std::string& descriptor,
                                                              const std::string& instance,
                                                              bool retry, bool getStub) {
+    sp<IServiceManager1_1> sm;
+    if (!kIsRecovery) {
+        sm = defaultServiceManager1_1();
+    }
+    return getRawServiceFrom(sm, descriptor, instance, retry, getStub,
+                             true /* useManifestIndex */);
+}
+
+sp<::android::hidl::base::V1_0::IBase> getRawServiceInternal(const sp<IServiceManager1_1>& sm,
+                                                             const std::string& descriptor,
+                                                             const std::string& instance,
+                                                             bool retry, bool getStub) {
+    return getRawServiceFrom(sm, descriptor, instance, retry, getStub,
+                             false /* useManifestIndex */);
+}
+
+static sp<::android::hidl::base::V1_0::IBase> getRawServiceFrom(const sp<IServiceManager1_1>& sm,
+                                                                const std::string& descriptor,
+                                                                const std::string& instance,
+                                                                bool retry, bool getStub,
+                                                                bool useManifestIndex) {
     using Transport = IServiceManager1_0::Transport;
     sp<Waiter> waiter;
 
-    sp<IServiceManager1_1> sm;
     Transport transport = Transport::EMPTY;
     if (kIsRecovery) {
         transport = Transport::PASSTHROUGH;
     } else {
-        sm = defaultServiceManager1_1();
         if (sm == nullptr) {
             ALOGE("getService: defaultServiceManager() is null");
             return nullptr;
         }
 
-        Return<Transport> transportRet = sm->getTransport(descriptor, instance);
+        if (!useManifestIndex || !getLocalTransport(descriptor, instance, &transport)) {
+            Return<Transport> transportRet = sm->getTransport(descriptor, instance);
 
-        if (!transportRet.isOk()) {
-            ALOGE("getService: defaultServiceManager()->getTransport returns %s",
-                  transportRet.description().c_str());
-            return nullptr;
+            if (!transportRet.isOk()) {
+                ALOGE("getService: defaultServiceManager()->getTransport returns %s",
+                      transportRet.description().c_str());
+                return nullptr;
+            }
+            transport = transportRet;
         }
-        transport = transportRet;
     }
 
     const bool vintfHwbinder = (transport == Transport::HWBINDER);
@@ -962,7 +1094,7 @@ status_t registerAsServiceInternal(const sp<IBase>& service, const std::string&
         return INVALID_OPERATION;
     }
 
-    const std::string descriptor = getDescriptor(service.get());
+    const char* descriptor = getInternedDescriptor(service.get());
 
     if (kEnforceVintfManifest && !isTrebleTestingOverride()) {
         using Transport = IServiceManager1_0::Transport;
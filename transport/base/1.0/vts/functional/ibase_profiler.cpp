@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ibase_profiler.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+#include <android-base/stringprintf.h>
+#include <hidl/HidlSupport.h>
+
+using android::sp;
+using android::base::StringAppendF;
+using android::hardware::hidl_handle;
+using android::hardware::Return;
+using android::hidl::base::V1_0::IBase;
+using std::chrono::nanoseconds;
+
+std::chrono::nanoseconds IBaseLatency::percentile(double p) const {
+    if (samples.empty()) return nanoseconds(0);
+    size_t rank = static_cast<size_t>(ceil(p * samples.size() / 100));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+std::vector<IBaseLatency> ProfileIBase(const sp<IBase>& service, const std::string& hal,
+                                       size_t iterations) {
+    const std::vector<std::pair<std::string, std::function<bool()>>> methods = {
+            {"ping", [&] { return service->ping().isOk(); }},
+            {"interfaceChain", [&] { return service->interfaceChain([](const auto&) {}).isOk(); }},
+            {"getHashChain", [&] { return service->getHashChain([](const auto&) {}).isOk(); }},
+            {"debug", [&] { return service->debug(hidl_handle(), {}).isOk(); }},
+    };
+
+    std::vector<IBaseLatency> latencies;
+    for (const auto& [method, call] : methods) {
+        IBaseLatency latency;
+        latency.hal = hal;
+        latency.method = method;
+        latency.samples.reserve(iterations);
+        for (size_t i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            bool ok = call();
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if (ok) {
+                latency.samples.push_back(elapsed);
+            } else {
+                latency.failures++;
+            }
+        }
+        std::sort(latency.samples.begin(), latency.samples.end());
+        latencies.push_back(std::move(latency));
+    }
+    return latencies;
+}
+
+std::vector<const IBaseLatency*> FindOutliers(const std::vector<IBaseLatency>& latencies,
+                                              double factor, nanoseconds floor) {
+    std::map<std::string, std::vector<nanoseconds>> p99s;
+    for (const IBaseLatency& latency : latencies) {
+        if (!latency.samples.empty()) p99s[latency.method].push_back(latency.percentile(99));
+    }
+
+    std::map<std::string, nanoseconds> medians;
+    for (auto& [method, values] : p99s) {
+        auto middle = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), middle, values.end());
+        medians[method] = *middle;
+    }
+
+    std::vector<const IBaseLatency*> outliers;
+    for (const IBaseLatency& latency : latencies) {
+        if (latency.samples.empty()) continue;
+        nanoseconds p99 = latency.percentile(99);
+        if (p99 >= floor && p99.count() > factor * medians[latency.method].count()) {
+            outliers.push_back(&latency);
+        }
+    }
+    return outliers;
+}
+
+std::string FormatLatencies(const std::vector<IBaseLatency>& latencies) {
+    auto us = [](nanoseconds ns) { return ns.count() / 1000.0; };
+
+    std::string out;
+    for (const IBaseLatency& latency : latencies) {
+        StringAppendF(&out, "%s %s: p50 %.1fus p90 %.1fus p99 %.1fus max %.1fus",
+                      latency.hal.c_str(), latency.method.c_str(), us(latency.percentile(50)),
+                      us(latency.percentile(90)), us(latency.percentile(99)),
+                      us(latency.percentile(100)));
+        if (latency.failures > 0) StringAppendF(&out, " (%zu failed)", latency.failures);
+        out += "\n";
+    }
+    return out;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VTS_IBASE_PROFILER_H
+#define VTS_IBASE_PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <android/hidl/base/1.0/IBase.h>
+
+// Latencies of one IBase method of one HAL.
+struct IBaseLatency {
+    std::string hal;     // e.x. android.hardware.foo@1.0::IFoo/default
+    std::string method;  // ping, interfaceChain, getHashChain or debug
+    std::vector<std::chrono::nanoseconds> samples;  // sorted, successful calls only
+    size_t failures = 0;
+
+    // Nearest-rank percentile (0 < p <= 100) of the samples, or 0 if there are none.
+    std::chrono::nanoseconds percentile(double p) const;
+};
+
+// Calls each profiled IBase method of service iterations times, one method after the other.
+std::vector<IBaseLatency> ProfileIBase(const android::sp<android::hidl::base::V1_0::IBase>& service,
+                                       const std::string& hal, size_t iterations);
+
+// Returns the latencies whose p99 is more than factor times the median p99 of the same method
+// across all HALs, and at least floor. These point at HALs with starved binder thread pools or
+// slow implementations.
+std::vector<const IBaseLatency*> FindOutliers(const std::vector<IBaseLatency>& latencies,
+                                              double factor, std::chrono::nanoseconds floor);
+
+// One line per latency, with its p50, p90, p99 and max in microseconds.
+std::string FormatLatencies(const std::vector<IBaseLatency>& latencies);
+
+#endif  // VTS_IBASE_PROFILER_H
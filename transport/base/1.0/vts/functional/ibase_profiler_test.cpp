@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the profiler of vts_ibase_test against in-process stand-ins for HALs, so that it can be
+// tested on the host.
+
+#include <algorithm>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "ibase_profiler.h"
+
+using android::sp;
+using android::hardware::Return;
+using android::hardware::Void;
+using android::hidl::base::V1_0::IBase;
+using namespace std::chrono_literals;
+
+struct StandInHal : public IBase {
+    explicit StandInHal(std::chrono::microseconds interfaceChainDelay)
+        : mInterfaceChainDelay(interfaceChainDelay) {}
+
+    Return<void> interfaceChain(interfaceChain_cb _hidl_cb) override {
+        std::this_thread::sleep_for(mInterfaceChainDelay);
+        _hidl_cb({"android.hidl.standin@1.0::IStandIn", IBase::descriptor});
+        return Void();
+    }
+
+    const std::chrono::microseconds mInterfaceChainDelay;
+};
+
+TEST(IBaseProfilerTest, Percentile) {
+    IBaseLatency latency;
+    EXPECT_EQ(0ns, latency.percentile(50));
+
+    for (int i = 1; i <= 10; ++i) latency.samples.push_back(std::chrono::nanoseconds(i));
+    EXPECT_EQ(1ns, latency.percentile(1));
+    EXPECT_EQ(5ns, latency.percentile(50));
+    EXPECT_EQ(9ns, latency.percentile(90));
+    EXPECT_EQ(10ns, latency.percentile(99));
+    EXPECT_EQ(10ns, latency.percentile(100));
+}
+
+TEST(IBaseProfilerTest, ProfilesEachMethod) {
+    std::vector<IBaseLatency> latencies = ProfileIBase(new StandInHal(0us), "standin", 5);
+
+    ASSERT_EQ(4u, latencies.size());
+    for (const IBaseLatency& latency : latencies) {
+        EXPECT_EQ("standin", latency.hal);
+        EXPECT_EQ(5u, latency.samples.size()) << latency.method;
+        EXPECT_EQ(0u, latency.failures) << latency.method;
+        EXPECT_TRUE(std::is_sorted(latency.samples.begin(), latency.samples.end()));
+    }
+}
+
+TEST(IBaseProfilerTest, FindsSlowHal) {
+    std::vector<IBaseLatency> latencies;
+    for (int i = 0; i < 8; ++i) {
+        std::string hal = "fast" + std::to_string(i);
+        for (IBaseLatency& latency : ProfileIBase(new StandInHal(0us), hal, 20)) {
+            latencies.push_back(std::move(latency));
+        }
+    }
+    for (IBaseLatency& latency : ProfileIBase(new StandInHal(5ms), "slow", 20)) {
+        latencies.push_back(std::move(latency));
+    }
+
+    std::vector<const IBaseLatency*> outliers = FindOutliers(latencies, 10, 1ms);
+    ASSERT_EQ(1u, outliers.size()) << FormatLatencies(latencies);
+    EXPECT_EQ("slow", outliers[0]->hal);
+    EXPECT_EQ("interfaceChain", outliers[0]->method);
+
+    // nothing is slow in absolute terms
+    EXPECT_TRUE(FindOutliers(latencies, 10, 1s).empty());
+}
@@ -15,8 +15,11 @@
  */
 #define LOG_TAG "vts_ibase_test"
 
+#include <string.h>
+
 #include <algorithm>
 #include <functional>
+#include <iostream>
 #include <map>
 #include <mutex>
 #include <string>
@@ -24,6 +27,7 @@
 #include <vector>
 
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
 #include <android/hidl/base/1.0/IBase.h>
@@ -34,6 +38,8 @@
 #include <hidl/ServiceManagement.h>
 #include <init-test-utils/service_utils.h>
 
+#include "ibase_profiler.h"
+
 using android::FqInstance;
 using android::FQName;
 using android::sp;
@@ -51,6 +57,13 @@ using android::hidl::manager::V1_0::IServiceManager;
 using android::init::ServiceInterfacesMap;
 using PidInterfacesMap = std::map<pid_t, std::set<FqInstance>>;
 
+// Set by --profile_iterations. If non-zero, the Latency test profiles IBase calls.
+static size_t gProfileIterations = 0;
+// A HAL is an outlier if its p99 is kOutlierFactor times the median of all HALs and at least
+// kOutlierFloor.
+static constexpr double kOutlierFactor = 10;
+static constexpr std::chrono::milliseconds kOutlierFloor{1};
+
 template <typename T>
 static inline ::testing::AssertionResult isOk(const ::android::hardware::Return<T>& ret) {
     return ret.isOk() ? (::testing::AssertionSuccess() << ret.description())
@@ -248,6 +261,31 @@ TEST_F(VtsHalBaseV1_0TargetTest, HashChain) {
     });
 }
 
+TEST_F(VtsHalBaseV1_0TargetTest, Latency) {
+    if (gProfileIterations == 0) {
+        GTEST_SKIP() << "Pass --profile_iterations=N to profile IBase latencies";
+    }
+
+    std::vector<IBaseLatency> latencies;
+    EachHal([&](const Hal& base) {
+        for (IBaseLatency& latency : ProfileIBase(base.service, base.name, gProfileIterations)) {
+            EXPECT_EQ(0u, latency.failures) << latency.method << " failed on " << base.name;
+            latencies.push_back(std::move(latency));
+        }
+    });
+    std::cout << FormatLatencies(latencies);
+
+    for (const IBaseLatency* outlier : FindOutliers(latencies, kOutlierFactor, kOutlierFloor)) {
+        int64_t p99 = std::chrono::duration_cast<std::chrono::microseconds>(
+                              outlier->percentile(99))
+                              .count();
+        LOG(WARNING) << "Slow " << outlier->method << " on " << outlier->hal << ": p99 " << p99
+                     << "us";
+        RecordProperty("outlier_p99_us:" + outlier->hal + ":" + outlier->method,
+                       std::to_string(p99));
+    }
+}
+
 TEST_F(VtsHalBaseV1_0TargetTest, ServiceProvidesAndDeclaresTheSameInterfaces) {
     const Result<ServiceInterfacesMap> service_interfaces_map =
             android::init::GetOnDeviceServiceInterfacesMap();
@@ -332,5 +370,18 @@ TEST_F(VtsHalBaseV1_0TargetTest, ServiceProvidesAndDeclaresTheSameInterfaces) {
 
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
+
+    // Other arguments are left to the test runner.
+    static constexpr const char* kProfileIterations = "--profile_iterations=";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (!android::base::StartsWith(arg, kProfileIterations)) continue;
+        if (!android::base::ParseUint(arg.substr(strlen(kProfileIterations)),
+                                      &gProfileIterations)) {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Hosts several passthrough HALs in one process, instead of a process each:
+//
+//     hidl_passthrough_host <config> [<max threads>]
+//
+// See parsePassthroughServiceConfig in hidl/LegacySupport.h for the format of config.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <android-base/parseint.h>
+#include <hidl/LegacySupport.h>
+
+int main(int argc, char** argv) {
+    size_t maxThreads = 0;
+    if (argc < 2 || argc > 3 ||
+        (argc == 3 && !android::base::ParseUint(argv[2], &maxThreads, size_t{1024}))) {
+        fprintf(stderr, "usage: %s <config> [<max threads>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return android::hardware::defaultPassthroughServiceHost(argv[1], maxThreads);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace hardware {
+
+/**
+ * Admission control for the calls a HIDL server handles, so that one client cannot take all of
+ * the threads configured with configureRpcThreadpool. Calls are grouped by the calling client's
+ * pid and uid, and each client is held to a policy: how many of its calls may run at once, and
+ * how many it may make per second (a token bucket). A call over either limit fails right away,
+ * or waits for a while if the policy allows some calls to queue.
+ *
+ * A server method asks for admission before doing its work, and answers with its own error,
+ * e.x. a Result::BUSY, if it is refused:
+ *
+ *   Return<Result> Foo::bar() {
+ *       ClientAdmission::Ticket ticket = mAdmission.admit();
+ *       if (!ticket) return Result::BUSY;
+ *       ...
+ *   }
+ *
+ * A queued call still occupies a binder thread, so maxQueued should be small.
+ */
+class ClientAdmission {
+    struct ClientState;
+
+   public:
+    struct Client {
+        pid_t pid;
+        uid_t uid;
+
+        bool operator<(const Client& other) const {
+            return pid != other.pid ? pid < other.pid : uid < other.uid;
+        }
+    };
+
+    struct Policy {
+        size_t maxConcurrent = 0;  // calls running at once, 0: no limit
+        double ratePerSecond = 0;  // sustained calls per second, 0: no limit
+        size_t burst = 1;          // calls which may be made at once on top of the rate
+        size_t maxQueued = 0;      // calls waiting to be admitted, 0: refuse calls over the limits
+        std::chrono::nanoseconds maxQueueDelay = std::chrono::milliseconds(100);
+    };
+
+    struct ClientStats {
+        Client client;
+        uint64_t admitted = 0;
+        uint64_t rejected = 0;
+        uint64_t queued = 0;  // calls which had to wait, whether or not they were admitted
+        size_t inFlight = 0;
+        size_t peakInFlight = 0;
+        std::chrono::nanoseconds queueTime{0};  // total time calls waited
+    };
+
+    // Admission of one call. It is released when destroyed, e.x. when the call returns.
+    class Ticket {
+       public:
+        Ticket() = default;
+        Ticket(Ticket&& other);
+        Ticket& operator=(Ticket&& other);
+        ~Ticket();
+
+        // Whether the call was admitted
+        explicit operator bool() const { return mAdmission != nullptr; }
+
+       private:
+        friend class ClientAdmission;
+        Ticket(ClientAdmission* admission, ClientState* state);
+        void release();
+
+        ClientAdmission* mAdmission = nullptr;
+        ClientState* mState = nullptr;
+    };
+
+    explicit ClientAdmission(const Policy& policy);
+
+    // Policy for the clients of one uid, instead of the default
+    void setPolicy(uid_t uid, const Policy& policy);
+
+    // Admits a call from the client of the current binder transaction.
+    Ticket admit();
+    Ticket admit(const Client& client);
+
+    std::vector<ClientStats> getStats();
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct ClientState {
+        Policy policy;
+        ClientStats stats;
+        size_t waiting = 0;
+        double tokens = 0;  // of the token bucket
+        Clock::time_point refilled;
+        Clock::time_point lastSeen;
+
+        void refill(Clock::time_point now);
+        bool canAdmit() const;
+        void admit();
+        // When the bucket will next have a token, if that is what calls wait for
+        Clock::time_point nextToken() const;
+    };
+
+    // must hold mMutex
+    ClientState& stateLocked(const Client& client, Clock::time_point now);
+    const Policy& policyLocked(uid_t uid) const;
+
+    void release(ClientState* state);
+
+    std::mutex mMutex;
+    std::condition_variable mReleased;
+    const Policy mDefaultPolicy;
+    std::map<uid_t, Policy> mPolicies;
+    std::map<Client, ClientState> mClients;
+};
+
+}  // namespace hardware
+}  // namespace android
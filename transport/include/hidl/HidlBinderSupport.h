@@ -72,6 +72,29 @@ status_t readEmbeddedFromParcel(const hidl_string &string,
 status_t writeEmbeddedToParcel(const hidl_string &string,
         Parcel *parcel, size_t parentHandle, size_t parentOffset);
 
+// Requirements on the contents of a received hidl_string.
+struct hidl_string_requirements {
+    size_t maxSize = SIZE_MAX;
+    bool noEmbeddedNul = true;
+    bool utf8 = true;
+};
+
+// Reads string like the above, then checks its contents against requirements in one pass
+// (see validateHidlString) and returns BAD_VALUE if they are not met. If validation is set, it
+// receives the result so that later consumers need not rescan the string.
+status_t readEmbeddedFromParcel(const hidl_string& string, const Parcel& parcel,
+                                size_t parentHandle, size_t parentOffset,
+                                const hidl_string_requirements& requirements,
+                                hidl_string_validation* validation = nullptr);
+
+// ---------------------- hidl_string_list
+
+status_t readEmbeddedFromParcel(const hidl_string_list& list, const Parcel& parcel,
+                                size_t parentHandle, size_t parentOffset);
+
+status_t writeEmbeddedToParcel(const hidl_string_list& list, Parcel* parcel, size_t parentHandle,
+                               size_t parentOffset);
+
 // ---------------------- Status
 
 // Bear in mind that if the client or service is a Java endpoint, this
@@ -178,12 +201,106 @@ template<typename T, MQFlavor flavor>
     return _hidl_err;
 }
 
+// ---------------------- parcel size precomputation
+
+// What writing a value adds to a Parcel: dataSize bytes of Parcel data (binder object
+// headers and inline scalars), objectCount entries in its object table and bufferSize bytes
+// of scatter-gather buffers copied by the driver.
+struct ParcelSize {
+    size_t dataSize = 0;
+    size_t objectCount = 0;
+    size_t bufferSize = 0;
+
+    ParcelSize& operator+=(const ParcelSize& other) {
+        dataSize += other.dataSize;
+        objectCount += other.objectCount;
+        bufferSize += other.bufferSize;
+        return *this;
+    }
+};
+
+// Size of a single buffer object (writeBuffer/writeEmbeddedBuffer) of the given length.
+ParcelSize computeBufferParcelSize(size_t length);
+
+// The following mirror writeEmbeddedToParcel for the same types.
+ParcelSize computeEmbeddedParcelSize(const hidl_handle& handle);
+ParcelSize computeEmbeddedParcelSize(const hidl_memory& memory);
+ParcelSize computeEmbeddedParcelSize(const hidl_string& string);
+
+// Types without embedded buffers are written in place as part of their parent's buffer.
+template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>::value>>
+ParcelSize computeEmbeddedParcelSize(const T& /* value */) {
+    return ParcelSize{};
+}
+
+template <typename T>
+ParcelSize computeEmbeddedParcelSize(const hidl_vec<T>& vec) {
+    ParcelSize size = computeBufferParcelSize(sizeof(T) * vec.size());
+    if (!std::is_trivially_copyable<T>::value) {
+        for (size_t i = 0; i < vec.size(); ++i) {
+            size += computeEmbeddedParcelSize(vec[i]);
+        }
+    }
+    return size;
+}
+
+template <typename T, size_t SIZE1, size_t... SIZES>
+ParcelSize computeEmbeddedParcelSize(const hidl_array<T, SIZE1, SIZES...>& array) {
+    ParcelSize size;
+    if (!std::is_trivially_copyable<T>::value) {
+        for (size_t i = 0; i < array.elementCount(); ++i) {
+            size += computeEmbeddedParcelSize(array.data()[i]);
+        }
+    }
+    return size;
+}
+
+inline ParcelSize computeEmbeddedParcelSize(const hidl_string_list& list) {
+    ParcelSize size = computeEmbeddedParcelSize(list.chars());
+    size += computeEmbeddedParcelSize(list.offsets());
+    return size;
+}
+
+template <typename T, MQFlavor flavor>
+ParcelSize computeEmbeddedParcelSize(const MQDescriptor<T, flavor>& obj) {
+    ParcelSize size = computeEmbeddedParcelSize(obj.grantors());
+    size += computeEmbeddedParcelSize(hidl_handle(obj.handle()));
+    return size;
+}
+
+// Size of value when written as a top-level argument, i.e. with writeBuffer followed by
+// writeEmbeddedToParcel. Generated structs are supported once they provide a
+// computeEmbeddedParcelSize overload next to their writeEmbeddedToParcel.
+template <typename T>
+ParcelSize computeParcelSize(const T& value) {
+    ParcelSize size = computeBufferParcelSize(sizeof(T));
+    size += computeEmbeddedParcelSize(value);
+    return size;
+}
+
+// Number of binder objects writeEmbeddedToParcel adds for value.
+template <typename T>
+size_t countEmbeddedObjects(const T& value) {
+    return computeEmbeddedParcelSize(value).objectCount;
+}
+
+// Grows the data capacity of parcel once, so that writing size more does not reallocate.
+status_t reserveParcelSize(Parcel* parcel, const ParcelSize& size);
+
 // ---------------------- support for casting interfaces
 
 // Constructs a binder for this interface and caches it. If it has already been created
 // then it returns it.
 sp<IBinder> getOrCreateCachedBinder(::android::hidl::base::V1_0::IBase* ifacePtr);
 
+namespace details {
+// Same as getDescriptor, but the string is interned, so it stays valid for the life of the
+// process. It is also cached on the interface's binder, if it has one, so that later calls for
+// the same interface neither call interfaceDescriptor nor take a process-wide lock. Returns "" on
+// error.
+const char* getInternedDescriptor(::android::hidl::base::V1_0::IBase* ifacePtr);
+}  // namespace details
+
 // Construct a smallest possible binder from the given interface.
 // If it is remote, then its remote() will be retrieved.
 // Otherwise, the smallest possible BnChild is found where IChild is a subclass of IType
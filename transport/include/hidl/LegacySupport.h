@@ -15,6 +15,7 @@
  */
 
 #include <string>
+#include <vector>
 
 #include <hidl/HidlLazyUtils.h>
 #include <hidl/HidlTransportSupport.h>
@@ -129,5 +130,47 @@ __attribute__((warn_unused_result)) status_t defaultLazyPassthroughServiceImplem
                                                                                    maxThreads);
 }
 
+/**
+ * A passthrough HAL hosted by defaultPassthroughServiceHost.
+ */
+struct PassthroughServiceEntry {
+    std::string interfaceName;  // e.x. android.hardware.foo@1.0::IFoo
+    std::string serviceName = "default";
+    // Registered like registerLazyPassthroughServiceImplementation.
+    bool lazy = false;
+};
+
+/**
+ * Parses a passthrough host configuration. Each line is an interface, optionally followed by an
+ * instance name (default: "default") and "lazy". Blank lines and text after '#' are ignored:
+ *
+ *     android.hardware.foo@1.0::IFoo
+ *     android.hardware.bar@1.0::IBar  internal  lazy
+ *
+ * Returns false and sets error if content is malformed.
+ */
+bool parsePassthroughServiceConfig(const std::string& content,
+                                   std::vector<PassthroughServiceEntry>* entries,
+                                   std::string* error);
+
+/**
+ * Registers passthrough implementations of all of the entries concurrently. Either all entries
+ * are lazy or none are, since lazy services exit the process once none of them have clients.
+ * Returns the first error, after every registration has finished.
+ */
+__attribute__((warn_unused_result)) status_t registerPassthroughServiceImplementations(
+        const std::vector<PassthroughServiceEntry>& entries);
+
+/**
+ * Hosts every HAL listed in the configuration at configPath (see parsePassthroughServiceConfig)
+ * in this process, sharing one thread pool. If maxThreads is 0, the pool has a thread per HAL,
+ * as many as the HALs would have had running separately with the default of one. This method
+ * never returns.
+ *
+ * Return value is exit status.
+ */
+__attribute__((warn_unused_result)) status_t defaultPassthroughServiceHost(
+        const std::string& configPath, size_t maxThreads = 0);
+
 }  // namespace hardware
 }  // namespace android
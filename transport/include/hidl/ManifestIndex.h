@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HIDL_MANIFEST_INDEX_H
+#define ANDROID_HIDL_MANIFEST_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace details {
+
+/**
+ * A compact index of the HIDL HALs declared in VINTF manifests, mapping
+ * (package@major::IInterface, instance) to the highest minor version declared and its transport.
+ * It is built from the manifest XML by hidl_manifest_index and memory-mapped at runtime, so that
+ * transports can be resolved without asking hwservicemanager to consult its VINTF objects.
+ *
+ * The index installed on the device is built from the framework manifest only, since the
+ * device manifests and manifest fragments are assembled elsewhere. So it answers for the HALs it
+ * contains, and has no answer for the others.
+ */
+class ManifestIndex {
+   public:
+    // Same values as IServiceManager::Transport.
+    enum class Transport : uint8_t {
+        EMPTY = 0,
+        HWBINDER = 1,
+        PASSTHROUGH = 2,
+    };
+
+    struct Entry {
+        std::string package;  // e.x. android.hidl.manager
+        uint32_t major;
+        uint32_t minor;
+        std::string interface;  // e.x. IServiceManager
+        std::string instance;   // e.x. default
+        Transport transport;
+    };
+
+    // Serializes entries.
+    static std::string build(std::vector<Entry> entries);
+
+    // Maps the index at path. Returns nullptr if it does not exist or is malformed.
+    static std::unique_ptr<ManifestIndex> open(const std::string& path);
+    // Same as open, but for an index already in memory.
+    static std::unique_ptr<ManifestIndex> fromData(std::string data);
+
+    ~ManifestIndex();
+
+    ManifestIndex(const ManifestIndex&) = delete;
+    ManifestIndex& operator=(const ManifestIndex&) = delete;
+
+    size_t size() const;
+
+    // Returns true and sets transport as hwservicemanager would for fqName (e.x.
+    // android.hidl.manager@1.2::IServiceManager) and instance, or returns false if the index has
+    // no answer.
+    bool getTransport(const std::string& fqName, const std::string& instance,
+                      Transport* transport) const;
+
+    // Calls f with each entry as "package@major.minor::IInterface", instance and transport.
+    void forEachEntry(
+            const std::function<void(const std::string&, const std::string&, Transport)>& f) const;
+
+   private:
+    struct Header;
+    struct RawEntry;
+
+    ManifestIndex() = default;
+    bool init(const uint8_t* data, size_t length);
+
+    // Index of the first entry whose key is not less than key.
+    size_t lowerBound(const std::string& key) const;
+    std::string keyOf(size_t index) const;
+
+    std::string mData;  // used by fromData
+    void* mMapping = nullptr;
+    size_t mMappingSize = 0;
+
+    const Header* mHeader = nullptr;
+    const RawEntry* mEntries = nullptr;
+    const char* mStrings = nullptr;
+};
+
+// The index of the manifests installed on this device, or nullptr if there is none.
+const ManifestIndex* getManifestIndex();
+
+}  // namespace details
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HIDL_MANIFEST_INDEX_H
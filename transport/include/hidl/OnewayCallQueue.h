@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <android/hidl/base/1.0/IBase.h>
+#include <hidl/Status.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+namespace hardware {
+
+/**
+ * Queues oneway calls per target interface and sends them in batches from a background thread,
+ * for clients which send many small notifications, e.x. one per sensor sample. A target's
+ * queued calls are sent once it has maxCalls of them, once they add up to maxBytes, or once
+ * the oldest has waited maxDelay, whichever comes first.
+ *
+ * A call queued with a coalescing key supersedes the calls to the same target with the same key
+ * which have not been sent yet: those are dropped, so a slow or busy target only receives the
+ * latest update.
+ *
+ * Calls to a target are sent in the order they were queued, one batch at a time. Calls made to
+ * the target directly, without the queue, may overtake queued ones. Once a call reports that the
+ * target died, the rest of its calls are dropped.
+ */
+class OnewayCallQueue {
+   public:
+    // Makes one oneway call, e.x. [=] { return sensor->onEvent(event); }
+    using Call = std::function<Return<void>()>;
+
+    // Calls queued without a key are never dropped.
+    static constexpr uint64_t kNoCoalescing = 0;
+
+    struct Config {
+        size_t maxCalls = 32;
+        size_t maxBytes = 16 * 1024;  // 0: no limit
+        std::chrono::nanoseconds maxDelay = std::chrono::milliseconds(1);
+    };
+
+    struct Stats {
+        uint64_t queued = 0;     // calls queued
+        uint64_t coalesced = 0;  // calls dropped because a later one superseded them
+        uint64_t sent = 0;       // calls made
+        uint64_t failed = 0;     // calls which returned an error or were dropped for a dead target
+        uint64_t batches = 0;
+    };
+
+    explicit OnewayCallQueue(const Config& config);
+    OnewayCallQueue();
+    // Sends all queued calls before returning.
+    ~OnewayCallQueue();
+
+    OnewayCallQueue(const OnewayCallQueue&) = delete;
+    OnewayCallQueue& operator=(const OnewayCallQueue&) = delete;
+
+    // Queues call to target. bytes is the call's approximate size, counted against maxBytes.
+    // Returns false if call is empty.
+    bool enqueue(const sp<::android::hidl::base::V1_0::IBase>& target, Call call,
+                 size_t bytes = 0, uint64_t coalescingKey = kNoCoalescing);
+
+    // Sends all calls queued so far, and waits until they have been made, or superseded. Calls
+    // queued meanwhile, e.x. by other threads, are not waited for. Must not be called from a
+    // queued call, which would wait for itself.
+    void flush();
+
+    Stats getStats();
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        uint64_t seq;
+        Call call;
+        size_t bytes;
+        uint64_t coalescingKey;
+        Clock::time_point queuedAt;
+    };
+
+    struct Target {
+        sp<::android::hidl::base::V1_0::IBase> target;
+        std::deque<Pending> calls;
+        size_t bytes = 0;
+    };
+
+    using TargetMap = std::map<const ::android::hidl::base::V1_0::IBase*, Target>;
+
+    // must hold mMutex
+    bool isDueLocked(const Target& target, Clock::time_point now) const;
+    // Whether all calls queued up to seq were made or superseded
+    bool isSentLocked(uint64_t seq) const;
+    // Finds the next target with calls to send, after the last one sent, so that a busy target
+    // does not starve the others. Otherwise sets wakeAt to when the next will be due.
+    TargetMap::iterator nextDueLocked(Clock::time_point now, Clock::time_point* wakeAt);
+
+    void run();
+
+    const Config mConfig;
+
+    std::mutex mMutex;
+    std::condition_variable mWork;
+    std::condition_variable mIdle;
+    TargetMap mTargets;
+    const ::android::hidl::base::V1_0::IBase* mLastSent = nullptr;
+    uint64_t mLastQueued = 0;   // seq of the last call queued
+    uint64_t mSendingFrom = 0;  // seq of the first call of the batch being sent, 0 if none
+    uint64_t mFlushUpTo = 0;    // calls up to this seq are due
+    size_t mFlushing = 0;       // threads waiting in flush
+    bool mStopping = false;
+    Stats mStats;
+
+    std::thread mThread;
+};
+
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <android/hidl/base/1.0/IBase.h>
+#include <hidl/HidlSupport.h>
+#include <hidl/Status.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+namespace hardware {
+
+/**
+ * Client-side cache of the responses of a service's methods which return the same data on every
+ * call, e.x. capabilities or static configuration, so that calling them in a loop does not cross
+ * binder each time. Responses are kept until they are invalidated, or for a time set per
+ * method, and all of them are forgotten if the service dies.
+ *
+ *   sp<IFoo> foo = IFoo::getService();
+ *   sp<ResponseCache> cache = ResponseCache::create(foo);
+ *   Return<uint32_t> version = cache->get<uint32_t>("getVersion", [&] {
+ *       return foo->getVersion();
+ *   });
+ *   cache->getWithCallback<Capabilities>(
+ *           "getCapabilities", [&](auto cb) { return foo->getCapabilities(cb); },
+ *           [&](const Capabilities& capabilities) { ... });
+ *   ...
+ *   cache->close();
+ *
+ * Errors are not cached. Each method must always be cached with the same types.
+ *
+ * A cache of a remote service is linked to its death, and the service's proxy keeps a record of
+ * that link until it is unlinked. So close must be called once a cache is no longer needed, or
+ * clients which create caches for a long-lived proxy leak one record per cache.
+ */
+class ResponseCache : public hidl_death_recipient {
+   public:
+    // Responses of a method with this TTL are kept until invalidated. This is the default.
+    static constexpr std::chrono::nanoseconds kNoExpiry = std::chrono::nanoseconds::max();
+
+    struct MethodStats {
+        std::string method;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0;  // cached responses dropped before they expired
+
+        double hitRate() const {
+            return hits + misses == 0 ? 0 : static_cast<double>(hits) / (hits + misses);
+        }
+    };
+
+    // Caches responses of service, and forgets them if it dies.
+    static sp<ResponseCache> create(const sp<::android::hidl::base::V1_0::IBase>& service);
+
+    // Unlinks from the death of the service, and stops caching its responses. Responses are
+    // fetched from the service every time after this.
+    void close();
+
+    // Responses of method expire ttl after they were fetched. 0 disables caching method.
+    void setTtl(const std::string& method, std::chrono::nanoseconds ttl);
+
+    void invalidate(const std::string& method);
+    void invalidateAll();
+
+    std::vector<MethodStats> getStats();
+
+    // Returns the cached response of method, or calls fetch and caches its response if it
+    // succeeds.
+    template <typename T, typename Fetch>
+    Return<T> get(const std::string& method, Fetch&& fetch) {
+        uint64_t generation;
+        std::shared_ptr<const void> cached = lookup(method, typeId<T>(), &generation);
+        if (cached != nullptr) return *std::static_pointer_cast<const T>(cached);
+
+        Return<T> ret = fetch();
+        if (ret.isOk()) store(method, typeId<T>(), generation, std::make_shared<const T>(ret));
+        return ret;
+    }
+
+    // Like get, for methods which return their results through a synchronous callback. call
+    // makes the HIDL call with the callback it is given, and callback receives the results,
+    // cached or not, after it returns.
+    template <typename... T, typename Call, typename Callback>
+    Return<void> getWithCallback(const std::string& method, Call&& call, Callback&& callback) {
+        using Results = std::tuple<T...>;
+        uint64_t generation;
+        std::shared_ptr<const void> cached = lookup(method, typeId<Results>(), &generation);
+        if (cached != nullptr) {
+            std::apply(callback, *std::static_pointer_cast<const Results>(cached));
+            return Void();
+        }
+
+        std::shared_ptr<const Results> results;
+        Return<void> ret =
+                call([&](const T&... args) { results = std::make_shared<const Results>(args...); });
+        if (!ret.isOk() || results == nullptr) return ret;
+        store(method, typeId<Results>(), generation, results);
+        std::apply(callback, *results);
+        return ret;
+    }
+
+    // Cached IBase methods, which never change for a service.
+    Return<void> interfaceChain(::android::hidl::base::V1_0::IBase::interfaceChain_cb _hidl_cb);
+    Return<void> interfaceDescriptor(
+            ::android::hidl::base::V1_0::IBase::interfaceDescriptor_cb _hidl_cb);
+    Return<void> getHashChain(::android::hidl::base::V1_0::IBase::getHashChain_cb _hidl_cb);
+
+    void serviceDied(uint64_t cookie,
+                     const wp<::android::hidl::base::V1_0::IBase>& who) override;
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::shared_ptr<const void> value;
+        const void* type;
+        Clock::time_point expires;
+    };
+
+    struct Method {
+        std::chrono::nanoseconds ttl = kNoExpiry;
+        bool cached = false;
+        Entry entry;
+        MethodStats stats;
+    };
+
+    explicit ResponseCache(const sp<::android::hidl::base::V1_0::IBase>& service);
+
+    // Since RTTI is not available
+    template <typename T>
+    static const void* typeId() {
+        static const char id = 0;
+        return &id;
+    }
+
+    // Returns the cached value of method, or nullptr and the generation to pass to store.
+    std::shared_ptr<const void> lookup(const std::string& method, const void* type,
+                                       uint64_t* generation);
+    // Does nothing if the cache was invalidated since generation.
+    void store(const std::string& method, const void* type, uint64_t generation,
+               std::shared_ptr<const void> value);
+
+    // must hold mMutex
+    void invalidateLocked(Method* method);
+
+    const sp<::android::hidl::base::V1_0::IBase> mService;
+
+    std::mutex mMutex;
+    std::map<std::string, Method> mMethods;
+    // Bumped on every invalidation, so that a response fetched across one is not cached.
+    uint64_t mGeneration = 0;
+    bool mLinked = false;  // to the service's death
+    bool mClosed = false;
+};
+
+}  // namespace hardware
+}  // namespace android
@@ -51,6 +51,12 @@ void waitForHwService(const std::string &interface, const std::string &instanceN
 // VINTF manifest for testing only.
 void setTrebleTestingOverride(bool testingOverride);
 
+// Looks up passthrough implementations in paths (each ending with '/') instead of the ODM, vendor,
+// VNDK-SP and system HAL directories. They are loaded in the sphal namespace like vendor HALs, so
+// on device paths must be ones it may load from. This is for benchmarks and tests; an empty list
+// restores the default directories.
+void setPassthroughLibraryPaths(const std::vector<std::string>& paths);
+
 void preloadPassthroughService(const std::string &descriptor);
 
 // Returns a service with the following constraints:
@@ -66,6 +72,12 @@ sp<::android::hidl::base::V1_0::IBase> getRawServiceInternal(const std::string&
                                                              const std::string& instance,
                                                              bool retry, bool getStub);
 
+// Same as above, but asks sm instead of defaultServiceManager1_1() (e.x. a stand-in service
+// manager in benchmarks). sm is not used when this is built for recovery.
+sp<::android::hidl::base::V1_0::IBase> getRawServiceInternal(
+        const sp<::android::hidl::manager::V1_1::IServiceManager>& sm,
+        const std::string& descriptor, const std::string& instance, bool retry, bool getStub);
+
 status_t registerAsServiceInternal(const sp<::android::hidl::base::V1_0::IBase>& service,
                                    const std::string& name);
 }  // namespace details
@@ -18,6 +18,7 @@
 
 #include <inttypes.h>
 
+#include <hidl/ResourceAccounting.h>
 #include <log/log.h>
 #include <sys/mman.h>
 
@@ -53,6 +54,9 @@ Return<sp<IMemory>> AshmemMapper::mapMemory(const hidl_memory& mem) {
         return nullptr;
     }
 
+    ::android::hardware::details::accountResourceAcquired(
+            ::android::hardware::details::SharedResource::ASHMEM_MAPPING, data, mem.size(),
+            __builtin_return_address(0), mem.name().c_str());
     return new AshmemMemory(mem, data);
 }
 
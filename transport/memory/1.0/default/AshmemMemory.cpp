@@ -16,6 +16,8 @@
 
 #include <sys/mman.h>
 
+#include <hidl/ResourceAccounting.h>
+
 #include "AshmemMemory.h"
 
 namespace android {
@@ -32,6 +34,8 @@ AshmemMemory::AshmemMemory(const hidl_memory& memory, void* data)
 AshmemMemory::~AshmemMemory()
 {
     // TODO: Move implementation to mapper class
+    ::android::hardware::details::accountResourceReleased(
+            ::android::hardware::details::SharedResource::ASHMEM_MAPPING, mData);
     munmap(mData, mMemory.size());
 }
 
@@ -88,6 +88,29 @@ $(GEN): $(SYSTEM_MANIFEST_INPUT_FILES) $(HOST_OUT_EXECUTABLES)/assemble_vintf
 		-i $(call normalize-path-list,$(PRIVATE_SYSTEM_MANIFEST_INPUT_FILES)) \
 		-o $@
 
+LOCAL_REQUIRED_MODULES := hidl_manifest_index.bin
+LOCAL_PREBUILT_MODULE_FILE := $(GEN)
+include $(BUILD_PREBUILT)
+
+SYSTEM_MANIFEST_GEN := $(GEN)
+
+# Index of the system manifest, for resolving framework HAL transports without asking
+# hwservicemanager. See ManifestIndex.h.
+include $(CLEAR_VARS)
+LOCAL_MODULE        := hidl_manifest_index.bin
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE   := $(LOCAL_PATH)/../NOTICE
+LOCAL_MODULE_STEM   := hidl_manifest_index.bin
+LOCAL_MODULE_CLASS  := ETC
+LOCAL_MODULE_PATH   := $(TARGET_OUT)/etc/hidl
+
+GEN := $(local-generated-sources-dir)/hidl_manifest_index.bin
+
+$(GEN): PRIVATE_INPUT_FILE := $(SYSTEM_MANIFEST_GEN)
+$(GEN): $(SYSTEM_MANIFEST_GEN) $(HOST_OUT_EXECUTABLES)/hidl_manifest_index
+	$(HOST_OUT_EXECUTABLES)/hidl_manifest_index -o $@ $(PRIVATE_INPUT_FILE)
+
 LOCAL_PREBUILT_MODULE_FILE := $(GEN)
 include $(BUILD_PREBUILT)
 
@@ -137,6 +160,7 @@ include $(BUILD_PREBUILT)
 
 VINTF_VNDK_VERSION :=
 SYSTEM_MANIFEST_INPUT_FILES :=
+SYSTEM_MANIFEST_GEN :=
 SYSTEM_EXT_MANIFEST_INPUT_FILES :=
 DEVICE_MATRIX_INPUT_FILE :=
 PRODUCT_MANIFEST_INPUT_FILES :=
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Builds the index read by ManifestIndex from assembled VINTF manifests:
+//
+//     hidl_manifest_index -o <output> <manifest.xml>...
+
+#include <stdio.h>
+#include <string.h>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <hidl/ManifestIndex.h>
+#include <vintf/HalManifest.h>
+#include <vintf/parse_xml.h>
+
+using android::hardware::details::ManifestIndex;
+
+static bool addManifest(const std::string& path, std::vector<ManifestIndex::Entry>* entries) {
+    std::string xml;
+    if (!android::base::ReadFileToString(path, &xml)) {
+        PLOG(ERROR) << "Could not read " << path;
+        return false;
+    }
+
+    android::vintf::HalManifest manifest;
+    std::string error;
+    if (!android::vintf::fromXml(&manifest, xml, &error)) {
+        LOG(ERROR) << "Could not parse " << path << ": " << error;
+        return false;
+    }
+
+    for (const std::string& name : manifest.getHalNames()) {
+        for (const android::vintf::ManifestHal* hal : manifest.getHals(name)) {
+            if (hal->format != android::vintf::HalFormat::HIDL) continue;
+
+            // Whether a deprecated HAL is served depends on the device's target level, which is
+            // only known at runtime, so leave it to hwservicemanager.
+            if (hal->getMaxLevel() != android::vintf::Level::UNSPECIFIED) continue;
+
+            hal->forEachInstance([&](const android::vintf::ManifestInstance& instance) {
+                ManifestIndex::Transport transport = ManifestIndex::Transport::EMPTY;
+                switch (instance.transport()) {
+                    case android::vintf::Transport::HWBINDER:
+                        transport = ManifestIndex::Transport::HWBINDER;
+                        break;
+                    case android::vintf::Transport::PASSTHROUGH:
+                        transport = ManifestIndex::Transport::PASSTHROUGH;
+                        break;
+                    default:
+                        break;
+                }
+                entries->push_back({instance.package(), instance.version().majorVer,
+                                    instance.version().minorVer, instance.interface(),
+                                    instance.instance(), transport});
+                return true;
+            });
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    android::base::InitLogging(argv);
+
+    std::string output;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (output.empty() || inputs.empty()) {
+        fprintf(stderr, "usage: %s -o <output> <manifest.xml>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<ManifestIndex::Entry> entries;
+    for (const std::string& input : inputs) {
+        if (!addManifest(input, &entries)) return 1;
+    }
+
+    if (!android::base::WriteStringToFile(ManifestIndex::build(std::move(entries)), output)) {
+        PLOG(ERROR) << "Could not write " << output;
+        return 1;
+    }
+    return 0;
+}